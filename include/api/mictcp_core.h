@@ -10,10 +10,32 @@
 
 int initialize_components(start_mode sm);
 
+/* Valeur de timeout de IP_recv() pour une lecture non bloquante */
+#define IP_NO_WAIT ((unsigned long) -1)
+/* Taille d'une adresse "a.b.c.d:port" renvoyée par IP_recv() */
+#define IP_ADDR_SIZE (INET_ADDRSTRLEN + 6)
+/* Limites d'un super-datagramme UDP GSO/GRO */
+#define IP_GSO_MAX_SEGMENTS 64
+#define IP_GSO_MAX_BYTES 65000
+#define IP_GRO_BUFFERS 8
+#define IP_GRO_BUFFER_SIZE 65536
+
 int IP_send(mic_tcp_pdu, mic_tcp_ip_addr);
+int IP_send_pooled(mic_tcp_pdu, mic_tcp_ip_addr);
 int IP_recv(mic_tcp_pdu* pk, mic_tcp_ip_addr* local_addr, mic_tcp_ip_addr* remote_addr, unsigned long timeout);
-int app_buffer_get(mic_tcp_payload);
-void app_buffer_put(mic_tcp_payload);
+int IP_resolve(const char* addr, struct sockaddr_in* result);
+int IP_set_batch_size(unsigned int size);
+int IP_set_offload(int enable);
+int IP_set_workers(unsigned int count);
+void IP_batch_begin(void);
+void IP_batch_end(void);
+void IP_get_io_stats(mic_tcp_io_stats* stats);
+int app_buffer_get(int queue, mic_tcp_payload, int wait);
+int app_buffer_readable(int queue);
+unsigned int app_buffer_depth(int queue);
+int app_buffer_put(int queue, mic_tcp_payload);
+int app_buffer_open(int queue);
+void app_buffer_close(int queue);
 
 void set_loss_rate(unsigned short);
 unsigned long get_now_time_msec();
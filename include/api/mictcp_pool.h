@@ -0,0 +1,39 @@
+#ifndef MICTCP_POOL_H
+#define MICTCP_POOL_H
+
+#include <mictcp.h>
+#include <stddef.h>
+
+/*****************************************************************
+ * Packet buffer pool.                                           *
+ * POOL_SIZE buffers are preallocated once; each thread keeps a  *
+ * small cache so that most allocations take no lock. Buffers    *
+ * are reference counted: the last pool_put() gives it back.     *
+ * When the pool is empty, a buffer is taken from the heap and   *
+ * counted as a miss.                                            *
+ *****************************************************************/
+
+#define POOL_SIZE 4096       /* Preallocated buffers */
+#define POOL_BUF_SIZE 1500   /* Bytes per buffer: a whole datagram */
+#define POOL_CACHE_SIZE 32   /* Buffers kept by each thread */
+
+typedef struct pool_buf
+{
+  struct pool_buf* next;     /* free list link */
+  int refcount;
+  int from_heap;             /* allocated on a miss, released with free() */
+  char data[POOL_BUF_SIZE];
+} pool_buf;
+
+pool_buf* pool_alloc(void);
+void pool_ref(pool_buf* buf);
+void pool_put(pool_buf* buf);
+void pool_get_stats(mic_tcp_pool_stats* stats);
+
+/* Buffer holding data, when data is the start of a pool buffer */
+static inline pool_buf* pool_buf_of(char* data)
+{
+  return (pool_buf*) (data - offsetof(pool_buf, data));
+}
+
+#endif
@@ -0,0 +1,47 @@
+#ifndef MICTCP_RING_H
+#define MICTCP_RING_H
+
+#include <mictcp.h>
+
+/*****************************************************************
+ * Single-producer / single-consumer ring of payloads.           *
+ * The producer (receive thread) never blocks: ring_push() fails *
+ * when the ring is full. The consumer only sleeps, on an        *
+ * eventfd, when the ring is empty.                              *
+ *****************************************************************/
+
+#define RING_SIZE 256        /* Slots per ring, power of 2 */
+#define RING_SLOT_SIZE MAX_PAYLOAD_SIZE
+#define CACHE_LINE_SIZE 64
+
+typedef struct ring_slot
+{
+  int size;
+  char data[RING_SLOT_SIZE];
+} ring_slot;
+
+typedef struct spsc_ring
+{
+  /* Consumer side */
+  unsigned int head __attribute__((aligned(CACHE_LINE_SIZE)));
+  unsigned int cached_tail;  /* consumer copy of tail, refreshed when empty */
+  int offset;                /* bytes of the head slot already read */
+  int consumer_waiting;      /* set while the consumer may sleep on efd */
+  /* Producer side */
+  unsigned int tail __attribute__((aligned(CACHE_LINE_SIZE)));
+  unsigned int cached_head;  /* producer copy of head, refreshed when full */
+  /* Shared, read-mostly */
+  int closed __attribute__((aligned(CACHE_LINE_SIZE)));
+  int efd;                   /* eventfd used to wake up the consumer */
+  ring_slot* slots;
+} spsc_ring;
+
+int ring_init(spsc_ring* ring);
+void ring_reset(spsc_ring* ring);
+int ring_push(spsc_ring* ring, const char* data, int size);
+int ring_pop(spsc_ring* ring, char* data, int max_size, int wait);
+int ring_readable(spsc_ring* ring);
+unsigned int ring_depth(spsc_ring* ring);
+void ring_close(spsc_ring* ring);
+
+#endif
@@ -12,13 +12,34 @@
 #include <unistd.h>
 #include <netdb.h>
 #include <pthread.h>
+#include <stdint.h>
 #include <sys/time.h>
 
 #define MAX_SOCKETS 1024 // Nombre maximum de sockets MIC-TCP
-#define MAX_TIMEOUT 100 // Timeout pour la réception d'un ACK en µs
-#define WINDOW_SIZE 10 // Taille de la fenêtre glissante
+#define EPHEMERAL_PORT_MIN 49152 // Premier port local attribué aux clients sans mic_tcp_bind()
+#define EPHEMERAL_PORT_MAX 65535 // Dernier port local attribué aux clients sans mic_tcp_bind()
+#define INITIAL_RTO 100000 // RTO en µs avant la première mesure de RTT
+#define DEFAULT_MIN_RTO 5000 // Borne basse par défaut du RTO en µs (modifiable par socket)
+#define DEFAULT_MAX_RTO 2000000 // Borne haute par défaut du RTO en µs (modifiable par socket)
+#define WINDOW_SIZE 10 // Taille par défaut de la fenêtre des pertes (modifiable par socket)
+#define LOSS_WINDOW_MAX 4096 // Taille maximale de la fenêtre des pertes (multiple de 64)
 #define REAL_LOSS 20 // Taux de perte acceptable en % (modifiable)
 #define DEFAULT_ACCEPTABLE_LOSS 20 // Taux de perte acceptable en % (modifiable)
+#define SEND_WINDOW_SIZE 64 // Nombre maximum de PDU en vol (fenêtre d'émission)
+#define MAX_PAYLOAD_SIZE 1484 // Taille maximale des données utiles d'un PDU (1500 - entête)
+#define RECV_WINDOW_SIZE 128 // Nombre maximum de PDU conservés hors séquence par le puits
+#define MAX_SACK_BLOCKS 8 // Nombre maximum de blocs SACK transportés par un ACK
+#define DUP_THRESH 3 // Nombre de PDU acquittés sélectivement au-delà d'un trou pour le déclarer perdu
+#define DEFAULT_ACK_DELAY 2000 // Attente max en µs d'un ACK retardé (inférieure à DEFAULT_MIN_RTO)
+#define DEFAULT_LINGER 5000000 // Attente max en µs de mic_tcp_close() pour les PDU encore en vol (modifiable par socket)
+#define MIC_TCP_BATCH_MAX 64 // Nombre maximum de datagrammes lus ou envoyés par appel système
+#define MIC_TCP_BATCH_DEFAULT 32 // Taille de lot par défaut du thread de réception (1 : un datagramme par appel)
+#define MIC_TCP_MAX_WORKERS 64 // Nombre maximum de threads de réception d'un serveur
+#define MIC_TCP_CQ_SIZE 128 // Nombre maximum d'opérations asynchrones en cours ou terminées non lues, par socket
+
+// Comparaison de numéros de séquence robuste au rebouclage
+#define SEQ_LT(a, b) ((int)((unsigned int)(a) - (unsigned int)(b)) < 0)
+#define SEQ_LEQ(a, b) ((int)((unsigned int)(a) - (unsigned int)(b)) <= 0)
 
 
 /*
@@ -65,8 +86,169 @@ typedef struct mic_tcp_sock
   mic_tcp_sock_addr remote_addr; /* adresse distante du socket */
   pthread_mutex_t mutex; /* mutex pour la synchronisation */
   pthread_cond_t cond; /* condition pour la synchronisation */
+  int in_use; /* 1 si le descripteur est attribué */
 } mic_tcp_sock;
 
+/*
+ * Algorithmes de contrôle de congestion (option MIC_TCP_CONGESTION)
+ */
+typedef enum mic_tcp_cc_algo { MIC_TCP_CC_RENO, MIC_TCP_CC_CUBIC } mic_tcp_cc_algo;
+
+/*
+ * Options réglables par socket avec mic_tcp_set_option() et mic_tcp_get_option()
+ */
+typedef enum mic_tcp_option
+{
+  MIC_TCP_RTO_MIN, /* borne basse du RTO en µs */
+  MIC_TCP_RTO_MAX, /* borne haute du RTO en µs */
+  MIC_TCP_CONGESTION, /* algorithme de contrôle de congestion (mic_tcp_cc_algo) */
+  MIC_TCP_NONBLOCK, /* 1 : accept, send et recv retournent -1 (errno EAGAIN) au lieu d'attendre */
+  MIC_TCP_STREAM, /* 1 : recv lit un flux d'octets (plusieurs PDU par appel), hérité par les connexions acceptées */
+  MIC_TCP_COALESCE, /* > 0 : regroupe les petits envois (Nagle), un PDU incomplet attend au plus cette durée en µs ; hérité */
+  MIC_TCP_CORK, /* 1 : les PDU incomplets attendent d'être pleins, mic_tcp_flush() ou le retour à 0 */
+  MIC_TCP_ACK_EVERY, /* N > 1 : ACK retardé, un ACK pour N PDU reçus dans l'ordre (1 par défaut) ; hérité */
+  MIC_TCP_ACK_DELAY, /* attente max en µs d'un ACK retardé (DEFAULT_ACK_DELAY par défaut) ; hérité */
+  MIC_TCP_LOSS_WINDOW, /* taille de la fenêtre des pertes en paquets (1 à LOSS_WINDOW_MAX, WINDOW_SIZE par défaut) */
+  MIC_TCP_LOSS_DECAY, /* > 0 : taux de perte à décroissance exponentielle, constante de temps en µs (0 : fenêtre) */
+  MIC_TCP_LOSS_TOLERANCE, /* taux de perte acceptable en % (0 : fiabilité totale), avant connect() ou sur le socket en écoute ;
+                            la connexion retient le plus strict du client et du serveur */
+  MIC_TCP_LINGER, /* attente max en µs de mic_tcp_close() pour les PDU en vol (DEFAULT_LINGER par défaut, 0 : aucune) ; hérité */
+  MIC_TCP_DEADLINE /* > 0 : durée de vie en µs des messages envoyés ensuite (fiabilité par échéance au lieu du taux
+                      de perte : un message n'est plus retransmis après son échéance) ; 0 : sans échéance ; hérité */
+} mic_tcp_option;
+
+/*
+ * Evénements de mic_tcp_poll()
+ */
+#define MIC_TCP_POLLIN 0x1 /* une donnée ou une connexion est prête (ou le socket est fermé) */
+#define MIC_TCP_POLLOUT 0x4 /* la fenêtre d'émission a de la place */
+#define MIC_TCP_POLLHUP 0x10 /* le socket est fermé */
+#define MIC_TCP_POLLNVAL 0x20 /* descripteur invalide */
+#define MIC_TCP_POLLCQ 0x40 /* des opérations asynchrones sont terminées */
+
+typedef struct mic_tcp_pollfd
+{
+  int fd; /* descripteur du socket */
+  short events; /* événements attendus */
+  short revents; /* événements prêts, remplis par mic_tcp_poll() */
+} mic_tcp_pollfd;
+
+/*
+ * Fin d'une opération asynchrone, lue avec mic_tcp_get_completions()
+ */
+typedef enum mic_tcp_completion_type
+{
+  MIC_TCP_SEND_ACKED, /* la donnée de mic_tcp_send_async() est acquittée */
+  MIC_TCP_SEND_ABANDONED, /* la donnée a été abandonnée (perte acceptée) */
+  MIC_TCP_RECV_DONE /* le tampon de mic_tcp_recv_async() est rempli */
+} mic_tcp_completion_type;
+
+typedef struct mic_tcp_completion
+{
+  int socket; /* descripteur du socket */
+  mic_tcp_completion_type type; /* opération terminée */
+  int result; /* nombre d'octets envoyés ou reçus */
+  void* user_data; /* valeur passée à la soumission */
+} mic_tcp_completion;
+
+/*
+ * Statistiques d'un socket, lues avec mic_tcp_get_stats()
+ */
+typedef struct mic_tcp_stats
+{
+  unsigned long srtt; /* RTT lissé en µs */
+  unsigned long rttvar; /* variation du RTT en µs */
+  unsigned long rto; /* RTO courant en µs (backoff compris) */
+  unsigned long last_rtt; /* dernière mesure de RTT en µs */
+  unsigned long min_rtt; /* plus petite mesure de RTT en µs */
+  unsigned int rtt_samples; /* nombre de mesures de RTT retenues */
+  unsigned int rto_expirations; /* nombre d'expirations du timer de retransmission */
+  unsigned int backoffs; /* nombre de doublements du RTO */
+  double cwnd; /* fenêtre de congestion en PDU */
+  double ssthresh; /* seuil de slow start en PDU */
+  unsigned int congestion_events; /* nombre de réductions de la fenêtre de congestion */
+  unsigned int coalesced_writes; /* envois regroupés dans un PDU déjà en attente */
+  unsigned int data_received; /* PDU de données reçus (doublons compris) */
+  unsigned int acks_sent; /* ACK de données envoyés */
+  unsigned int delayed_acks; /* ACK envoyés à l'expiration du délai d'ACK */
+  unsigned long bytes_sent; /* octets de données émis (hors retransmissions) */
+  unsigned long segments_sent; /* PDU de données émis (hors retransmissions) */
+  unsigned long retransmissions; /* PDU retransmis */
+  unsigned long losses_accepted; /* PDU abandonnés par la source (fiabilité partielle) */
+  unsigned long deadline_drops; /* PDU abandonnés par la source, échéance dépassée (MIC_TCP_DEADLINE) */
+  unsigned int forwards_sent; /* PDU FORWARD envoyés par la source pour annoncer des abandons */
+  unsigned int forwards_received; /* PDU FORWARD reçus par le puits */
+  unsigned int loss_rate; /* taux de perte mesuré sur la fenêtre des pertes, en % */
+  unsigned int loss_tolerance; /* taux de perte acceptable négocié pour la connexion, en % */
+  unsigned long bytes_received; /* octets délivrés à l'application */
+  unsigned long segments_skipped; /* PDU jamais reçus, sautés car abandonnés par la source */
+  unsigned int send_queue; /* PDU dans la fenêtre d'émission (en attente ou en vol) */
+  unsigned int reorder_queue; /* PDU conservés hors séquence par le puits */
+  unsigned int recv_queue; /* PDU en attente de lecture par l'application */
+} mic_tcp_stats;
+
+/*
+ * Segment de mémoire partagée publié par mic_tcp_stats_export() : les
+ * statistiques de chaque socket, recopiées périodiquement par le thread protocole.
+ * Un lecteur externe le projette en lecture seule et relit une entrée tant que
+ * son compteur sequence est impair ou a changé pendant la lecture
+ */
+#define MIC_TCP_STATS_MAGIC 0x5453434d /* "MCST" */
+#define MIC_TCP_STATS_VERSION 4
+#define MIC_TCP_STATS_PERIOD 100000 /* période de publication par défaut en µs */
+
+typedef struct mic_tcp_stats_entry
+{
+  unsigned int sequence; /* impair pendant la mise à jour de l'entrée */
+  int in_use; /* 1 si le descripteur est attribué */
+  int state; /* protocol_state du socket */
+  unsigned short local_port; /* port MIC-TCP local */
+  unsigned short remote_port; /* port MIC-TCP distant */
+  mic_tcp_stats stats;
+} mic_tcp_stats_entry;
+
+typedef struct mic_tcp_stats_segment
+{
+  unsigned int magic; /* MIC_TCP_STATS_MAGIC */
+  unsigned int version; /* MIC_TCP_STATS_VERSION */
+  unsigned int max_sockets; /* nombre d'entrées (MAX_SOCKETS) */
+  unsigned int pid; /* processus qui publie */
+  unsigned long period; /* période de publication en µs */
+  unsigned long updates; /* nombre de publications */
+  mic_tcp_stats_entry sockets[MAX_SOCKETS];
+} mic_tcp_stats_segment;
+
+/*
+ * Statistiques du pool de tampons de paquets (communes au processus),
+ * lues avec mic_tcp_get_pool_stats()
+ */
+typedef struct mic_tcp_pool_stats
+{
+  unsigned long capacity; /* nombre de tampons préalloués */
+  unsigned long in_use; /* tampons actuellement utilisés */
+  unsigned long high_watermark; /* plus grand nombre de tampons utilisés simultanément */
+  unsigned long allocs; /* nombre d'allocations */
+  unsigned long misses; /* allocations servies par le tas, pool épuisé */
+} mic_tcp_pool_stats;
+
+/*
+ * Statistiques des entrées/sorties par lots de la couche IP (communes au
+ * processus), lues avec mic_tcp_get_io_stats()
+ */
+typedef struct mic_tcp_io_stats
+{
+  unsigned int batch_size; /* nombre maximum de datagrammes par appel système */
+  unsigned long recv_calls; /* appels système de réception */
+  unsigned long recv_datagrams; /* datagrammes reçus */
+  unsigned long max_recv_batch; /* plus grand nombre de datagrammes reçus en un appel */
+  unsigned long send_calls; /* appels système d'envoi */
+  unsigned long send_datagrams; /* datagrammes envoyés */
+  int offload; /* 1 si GSO/GRO est actif */
+  unsigned long gso_sends; /* super-datagrammes GSO envoyés */
+  unsigned long gro_recvs; /* super-datagrammes GRO reçus */
+  unsigned int workers; /* nombre de threads de réception */
+} mic_tcp_io_stats;
+
 /*
  * Structure des données utiles d’un PDU MIC-TCP
  */
@@ -83,12 +265,15 @@ typedef struct mic_tcp_header
 {
   unsigned short source_port; /* numéro de port source */
   unsigned short dest_port; /* numéro de port de destination */
-  unsigned int seq_num; /* numéro de séquence */
-  unsigned int ack_num; /* numéro d'acquittement, 
-  inutile pour nous, car on peut identifier un pdu seulement avec son num seq */
+  unsigned int seq_num; /* numéro de séquence (pour un ACK : prochain numéro attendu) */
+  unsigned int ack_num; /* SYN : taux de perte négocié,
+  PDU de données et FORWARD : base de la fenêtre d'émission (tout ce qui précède est résolu côté source),
+  ACK : nombre de blocs SACK (mic_tcp_sack_block) transportés dans la charge utile */
   unsigned char syn; /* flag SYN (valeur 1 si activé et 0 si non) */
   unsigned char ack; /* flag ACK (valeur 1 si activé et 0 si non) */
   unsigned char fin; /* flag FIN (valeur 1 si activé et 0 si non) */
+  unsigned char fwd; /* flag FORWARD : PDU sans données, le puits saute les PDU abandonnés avant ack_num
+  (octet de bourrage de l'en-tête, dont la taille API_HD_Size ne change pas) */
 } mic_tcp_header;
 
 /*
@@ -108,15 +293,117 @@ typedef struct app_buffer
 } app_buffer;
 
 
-// Structure pour la fenêtre glissante pour la gestion des pertes
+// Structure pour la fenêtre glissante pour la gestion des pertes : le sort (perdu ou
+// acquitté) des size derniers paquets, dans un anneau de bits, et le nombre de pertes
+// parmi eux tenu à jour à chaque entrée et sortie. En mode décroissance (decay > 0),
+// pertes et paquets sont comptés avec un poids qui décroît avec leur âge
 typedef struct {
-   int sent_packets[WINDOW_SIZE];  // Tableau des paquets envoyés
-   int ack_received[WINDOW_SIZE];  // Tableau des ACK reçus
-   int window_index;               // Index courant
-   int packets_in_window;          // Nombre de paquets dans la fenêtre
+   uint64_t lost[LOSS_WINDOW_MAX / 64]; // Bit à 1 : paquet perdu (position % size)
+   unsigned int size;              // Taille de la fenêtre en paquets (option MIC_TCP_LOSS_WINDOW)
+   unsigned int lost_count;        // Pertes parmi les paquets de la fenêtre
+   unsigned long total;            // Paquets entrés dans la fenêtre (position du prochain)
+   unsigned long start;            // Position du premier paquet depuis la dernière réinitialisation
+   unsigned long decay;            // Constante de temps en µs du mode décroissance (0 : fenêtre)
+   double lost_weight;             // Mode décroissance : pertes pondérées
+   double total_weight;            // Mode décroissance : paquets pondérés
+   unsigned long last_update;      // Mode décroissance : date de la dernière pondération en µs
 } sliding_window_t;
 
+/*
+ * Etat d'un emplacement de la fenêtre d'émission
+ */
+typedef enum slot_state { SLOT_FREE, SLOT_QUEUED, SLOT_IN_FLIGHT, SLOT_ACKED, SLOT_ABANDONED } slot_state;
+
+// Emplacement de la fenêtre d'émission : un PDU en attente ou en vol et sa copie pour la retransmission
+typedef struct {
+   slot_state state;              // Etat de l'emplacement
+   unsigned int seq_num;          // Numéro de séquence du PDU
+   struct pool_buf* buf;          // Copie des données (tampon du pool, rendu quand le PDU est résolu)
+   int size;                      // Taille des données
+   unsigned long sent_time;       // Date du dernier envoi en µs
+   int transmissions;             // Nombre d'envois effectués
+   int in_loss_window;            // 1 si le PDU a déjà été compté dans la fenêtre des pertes
+   unsigned long loss_pos;        // Position du PDU dans la fenêtre des pertes
+   unsigned long loss_time;       // Date de son entrée dans la fenêtre des pertes en µs
+   int fast_retransmitted;        // 1 si le PDU a déjà été retransmis sur indication des SACK
+   int async;                     // 1 si le PDU vient de mic_tcp_send_async() (fin signalée par une complétion)
+   void* user_data;               // Valeur rendue dans la complétion
+   unsigned long deadline;        // Echéance de livraison en µs (0 : aucune, fiabilité selon le taux de perte)
+} send_slot_t;
 
+// Fenêtre d'émission Selective Repeat, indexée par seq_num % SEND_WINDOW_SIZE
+typedef struct {
+   send_slot_t slots[SEND_WINDOW_SIZE];
+   unsigned int base;             // Plus petit numéro de séquence non résolu (ni acquitté ni abandonné)
+   unsigned int next_to_send;     // Premier PDU en attente d'envoi (les suivants sont aussi en attente)
+   unsigned int outstanding;      // Nombre de PDU en vol non acquittés (limité par la fenêtre de congestion)
+} send_window_t;
+
+// Bloc SACK : intervalle [start, end[ de PDU reçus par le puits au-delà de l'ACK cumulatif
+typedef struct {
+   unsigned int start;
+   unsigned int end;
+} mic_tcp_sack_block;
+
+// Emplacement du tampon de réordonnancement du puits
+typedef struct {
+   int present;                   // 1 si le PDU est reçu et pas encore délivré
+   struct pool_buf* buf;          // Tampon du pool reçu du thread de réception (référence conservée)
+   char* data;                    // Données dans buf
+   int size;                      // Taille des données
+} recv_slot_t;
+
+// Tampon de réordonnancement borné, indexé par seq_num % RECV_WINDOW_SIZE
+typedef struct {
+   recv_slot_t slots[RECV_WINDOW_SIZE];
+} recv_window_t;
+
+// Compteurs de trafic d'un socket, publiés par mic_tcp_get_stats()
+typedef struct {
+   unsigned long bytes_sent;      // Octets de données émis (hors retransmissions)
+   unsigned long segments_sent;   // PDU de données émis (hors retransmissions)
+   unsigned long retransmissions; // PDU retransmis
+   unsigned long losses_accepted; // PDU abandonnés (perte acceptée)
+   unsigned long deadline_drops;  // PDU abandonnés car leur échéance est dépassée
+   unsigned int forwards_sent;    // PDU FORWARD envoyés
+   unsigned int forwards_received;// PDU FORWARD reçus
+   unsigned long bytes_received;  // Octets délivrés à l'application
+   unsigned long segments_skipped;// PDU sautés car abandonnés par la source
+   unsigned int segments_received;// PDU de données reçus (doublons compris)
+   unsigned int acks_sent;        // ACK de données envoyés
+   unsigned int delayed_acks;     // ACK envoyés à l'expiration du délai d'ACK
+   unsigned int coalesced_writes; // Envois regroupés dans un PDU déjà en attente
+} socket_counters_t;
+
+// Tampon fourni par mic_tcp_recv_async(), rempli directement par le thread de réception
+typedef struct {
+   char* data;
+   int size;
+   void* user_data;
+} async_recv_t;
+
+
+
+// Estimateur du RTT et calcul du RTO d'un socket (RFC 6298, règle de Karn)
+typedef struct {
+   unsigned long srtt;            // RTT lissé en µs (0 tant qu'aucune mesure)
+   unsigned long rttvar;          // Variation du RTT en µs
+   unsigned long rto;             // RTO courant en µs, backoff compris
+   unsigned long min_rto;         // Borne basse du RTO en µs
+   unsigned long max_rto;         // Borne haute du RTO en µs
+   unsigned long last_rtt;        // Dernière mesure en µs
+   unsigned long min_rtt;         // Plus petite mesure en µs
+   unsigned long backoff_time;    // Date du dernier doublement du RTO en µs
+   unsigned int samples;          // Nombre de mesures retenues
+   unsigned int expirations;      // Nombre d'expirations du timer
+   unsigned int backoffs;         // Nombre de doublements du RTO
+} rtt_estimator_t;
+
+// Suivi de l'envoi du SYN (client) ou du SYN-ACK (serveur) pendant l'établissement de connexion
+typedef struct {
+   unsigned long sent_time;       // Date du dernier envoi en µs
+   int attempts;                  // Nombre d'envois effectués (règle de Karn)
+} handshake_t;
 
 /****************************
  * Fonctions de l'interface *
@@ -129,5 +416,22 @@ int mic_tcp_send (int socket, char* mesg, int mesg_size);
 int mic_tcp_recv (int socket, char* mesg, int max_mesg_size);
 void process_received_PDU(mic_tcp_pdu pdu, mic_tcp_ip_addr local_addr, mic_tcp_ip_addr remote_addr);
 int mic_tcp_close(int socket);
+int mic_tcp_set_option(int socket, mic_tcp_option option, long value);
+int mic_tcp_get_option(int socket, mic_tcp_option option, long* value);
+int mic_tcp_flush(int socket);
+int mic_tcp_poll(mic_tcp_pollfd* fds, int nfds, int timeout);
+int mic_tcp_get_eventfd(int socket);
+int mic_tcp_send_async(int socket, char* mesg, int mesg_size, void* user_data);
+int mic_tcp_send_async_deadline(int socket, char* mesg, int mesg_size, void* user_data, long lifetime);
+int mic_tcp_recv_async(int socket, char* mesg, int max_mesg_size, void* user_data);
+int mic_tcp_get_completions(int socket, mic_tcp_completion* completions, int max, int timeout);
+int mic_tcp_get_stats(int socket, mic_tcp_stats* stats);
+int mic_tcp_get_pool_stats(mic_tcp_pool_stats* stats);
+int mic_tcp_set_batch_size(unsigned int size);
+int mic_tcp_set_offload(int enable);
+int mic_tcp_set_workers(unsigned int count);
+int mic_tcp_get_io_stats(mic_tcp_io_stats* stats);
+int mic_tcp_trace_open(const char* path);
+int mic_tcp_stats_export(const char* name, unsigned long period);
 
 #endif
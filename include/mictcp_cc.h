@@ -0,0 +1,63 @@
+#ifndef MICTCP_CC_H
+#define MICTCP_CC_H
+
+#include <mictcp.h>
+
+/*
+ * Contrôle de congestion de MIC-TCP
+ * Chaque algorithme fournit un jeu de fonctions (cc_ops_t) qui font évoluer
+ * l'état de congestion du socket (cc_state_t). La fenêtre de congestion est
+ * exprimée en nombre de PDU.
+ */
+
+#define CC_INITIAL_WINDOW 10 // Fenêtre de congestion initiale en PDU
+#define CC_MIN_WINDOW 2 // Fenêtre minimale après une perte en PDU
+#define CUBIC_C 0.4 // Constante d'agressivité de CUBIC (RFC 8312)
+#define CUBIC_BETA 0.7 // Facteur de réduction multiplicative de CUBIC
+
+/*
+ * Etat de congestion d'un socket (partagé par tous les algorithmes)
+ */
+typedef struct {
+   double cwnd;                   // Fenêtre de congestion en PDU
+   double ssthresh;               // Seuil de slow start en PDU
+   int in_recovery;               // 1 pendant la récupération d'une perte (NewReno)
+   unsigned int recovery_point;   // Numéro de séquence qui termine la récupération
+   // Etat propre à CUBIC
+   double w_max;                  // Fenêtre au moment de la dernière perte
+   double k;                      // Durée en s pour revenir à w_max
+   double w_est;                  // Estimation de la fenêtre de Reno (région "TCP friendly")
+   unsigned long epoch_start;     // Début de l'époque de croissance courante en µs (0 si aucune)
+} cc_state_t;
+
+/*
+ * Fonctions d'un algorithme de contrôle de congestion
+ */
+typedef struct {
+   const char* name;
+   /* Initialise l'état à l'ouverture de la connexion */
+   void (*init)(cc_state_t* cc);
+   /* acked PDU viennent d'être acquittés, rtt est le RTT lissé en µs */
+   void (*on_ack)(cc_state_t* cc, unsigned int acked, unsigned long rtt, unsigned long now);
+   /* Une perte est détectée par les SACK (une seule fois par épisode de perte) */
+   void (*on_loss)(cc_state_t* cc, unsigned long now);
+   /* Le timer de retransmission a expiré (une seule fois par épisode de perte) */
+   void (*on_timeout)(cc_state_t* cc, unsigned long now);
+} cc_ops_t;
+
+/*
+ * Contrôle de congestion d'un socket : algorithme choisi et son état
+ */
+typedef struct {
+   mic_tcp_cc_algo algo;          // Algorithme choisi
+   const cc_ops_t* ops;           // Fonctions de l'algorithme
+   cc_state_t state;              // Etat de l'algorithme
+   unsigned int events;           // Nombre de réductions de la fenêtre
+} congestion_ctl_t;
+
+extern const cc_ops_t cc_reno;
+extern const cc_ops_t cc_cubic;
+
+const cc_ops_t* cc_get_ops(mic_tcp_cc_algo algo);
+
+#endif
@@ -0,0 +1,35 @@
+#ifndef MICTCP_DEMUX_H
+#define MICTCP_DEMUX_H
+
+#include <mictcp.h>
+#include <stdint.h>
+
+/*
+ * Démultiplexage des PDU reçus vers les sockets MIC-TCP
+ * Les connexions sont rangées dans une table de hachage indexée par le
+ * quadruplet (port local, adresse distante, port distant) : le coût d'un
+ * PDU ne dépend pas du nombre de connexions. Les sockets en écoute sont
+ * rangés à part, par port local, et ne reçoivent que les SYN des nouvelles
+ * connexions. Une entrée par descripteur : les chaînages sont indexés par fd.
+ */
+
+#define DEMUX_BUCKETS 4096 // Nombre d'alvéoles de la table (puissance de 2)
+
+/*
+ * Clé d'une connexion
+ */
+typedef struct {
+   unsigned short local_port;     // Port MIC-TCP local
+   uint32_t remote_ip;            // Adresse IPv4 distante (ordre réseau)
+   unsigned short remote_udp_port;// Port UDP distant de la couche IP simulée (ordre réseau)
+   unsigned short remote_port;    // Port MIC-TCP distant
+} demux_key_t;
+
+int demux_insert(demux_key_t key, int fd);
+void demux_remove(int fd);
+int demux_lookup(demux_key_t key);
+int listener_insert(unsigned short port, int fd);
+void listener_remove(unsigned short port, int fd);
+int listener_lookup(unsigned short port);
+
+#endif
@@ -0,0 +1,29 @@
+#ifndef MICTCP_LOG_H
+#define MICTCP_LOG_H
+
+#include <stdio.h>
+
+/*
+ * Niveaux des messages de MIC-TCP, choisis à la compilation
+ * (make LOG_LEVEL=n, MIC_TCP_LOG_INFO par défaut)
+ * Les messages au-dessus du niveau choisi sont retirés par le compilateur :
+ * leurs arguments sont vérifiés mais jamais évalués. Les traces par paquet
+ * sont au niveau MIC_TCP_LOG_DEBUG ; pour observer le protocole sans coût
+ * d'affichage, voir la trace binaire (mictcp_trace.h)
+ */
+
+#define MIC_TCP_LOG_NONE 0 // Aucun message
+#define MIC_TCP_LOG_ERROR 1 // Erreurs
+#define MIC_TCP_LOG_INFO 2 // Etablissement et fermeture des connexions, changements de mode
+#define MIC_TCP_LOG_DEBUG 3 // Chaque appel, PDU, ACK et décision de perte
+
+#ifndef MIC_TCP_LOG_LEVEL
+#define MIC_TCP_LOG_LEVEL MIC_TCP_LOG_INFO
+#endif
+
+#define MIC_TCP_LOG(level, ...) do { if (MIC_TCP_LOG_LEVEL >= (level)) printf(__VA_ARGS__); } while (0)
+#define LOG_ERROR(...) MIC_TCP_LOG(MIC_TCP_LOG_ERROR, __VA_ARGS__)
+#define LOG_INFO(...) MIC_TCP_LOG(MIC_TCP_LOG_INFO, __VA_ARGS__)
+#define LOG_DEBUG(...) MIC_TCP_LOG(MIC_TCP_LOG_DEBUG, __VA_ARGS__)
+
+#endif
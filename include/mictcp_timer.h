@@ -0,0 +1,37 @@
+#ifndef MICTCP_TIMER_H
+#define MICTCP_TIMER_H
+
+#include <mictcp.h>
+
+/*
+ * Roue de timers hachée de MIC-TCP
+ * Tous les timers du protocole (retransmission, handshake, ...) sont rangés
+ * dans TIMER_WHEEL_SLOTS listes selon leur échéance, avec une résolution de
+ * TIMER_TICK_USEC. Le thread protocole dort jusqu'à la prochaine échéance,
+ * fait tourner la roue et appelle les fonctions des timers échus.
+ * Les dates sont celles de get_now_time_usec()
+ * (horloge monotone).
+ */
+
+#define TIMER_WHEEL_SLOTS 512 // Nombre d'emplacements de la roue
+#define TIMER_TICK_USEC 1000 // Résolution de la roue en µs
+
+typedef struct mic_tcp_timer
+{
+   unsigned long tick;            // Tick d'échéance
+   unsigned int generation;       // Incrémenté à chaque armement/annulation
+   int armed;                     // 1 si le timer est dans la roue
+   void (*callback)(void* arg);   // Fonction appelée à l'échéance (par le thread protocole)
+   void* arg;                     // Argument de la fonction
+   struct mic_tcp_timer* next;    // Chaînage dans l'emplacement de la roue
+   struct mic_tcp_timer* prev;
+} mic_tcp_timer;
+
+void timer_init(mic_tcp_timer* timer, void (*callback)(void*), void* arg);
+void timer_arm(mic_tcp_timer* timer, unsigned long expires);
+void timer_cancel(mic_tcp_timer* timer);
+int timer_is_armed(mic_tcp_timer* timer);
+void timer_wheel_run(unsigned long now);
+void timer_wheel_wait(void);
+
+#endif
@@ -0,0 +1,99 @@
+#ifndef MICTCP_TRACE_H
+#define MICTCP_TRACE_H
+
+#include <stdint.h>
+
+/*
+ * Trace binaire des événements du protocole
+ * Chaque thread écrit ses événements de taille fixe dans son propre anneau,
+ * sans verrou ni appel système : un seul écrivain par anneau, qui publie
+ * sa position après l'écriture. Les anneaux sont dans un fichier projeté en
+ * mémoire (mic_tcp_trace_open() ou variable d'environnement MIC_TCP_TRACE) :
+ * la trace survit à l'arrêt du processus et se décode hors ligne avec
+ * build/trace_decode. Quand un anneau est plein, les plus anciens
+ * événements du thread sont écrasés. Sans fichier de trace, un événement
+ * coûte un test ; compiler avec -DMIC_TCP_TRACE=0 retire les points de trace
+ *
+ * Fichier : un trace_header, puis TRACE_MAX_THREADS trace_ring
+ */
+
+#ifndef MIC_TCP_TRACE
+#define MIC_TCP_TRACE 1
+#endif
+
+#define TRACE_MAGIC 0x5452434d // "MCRT"
+#define TRACE_VERSION 1
+#define TRACE_MAX_THREADS 32 // Nombre maximum de threads tracés
+#define TRACE_RING_EVENTS 16384 // Evénements conservés par thread (puissance de 2)
+
+/*
+ * Types d'événements (les champs seq, ack et value dépendent du type)
+ */
+typedef enum trace_type
+{
+   TRACE_PDU_SENT = 1,         // seq, ack : base de la fenêtre, value : taille
+   TRACE_PDU_RETRANSMITTED,    // seq, ack : base de la fenêtre, value : numéro d'envoi
+   TRACE_ACK_RECEIVED,         // seq : prochain PDU attendu par le puits, ack : blocs SACK, value : PDU acquittés
+   TRACE_DATA_RECEIVED,        // seq, ack : prochain PDU attendu avant réception, value : taille
+   TRACE_ACK_SENT,             // seq : prochain PDU attendu, ack : blocs SACK, value : PDU reçus depuis l'ACK précédent
+   TRACE_RTO_EXPIRED,          // seq : PDU expiré, ack : base de la fenêtre, value : RTO en µs
+   TRACE_LOSS_ACCEPTED,        // seq : PDU abandonné, value : taux de perte en %
+   TRACE_LOSS_REFUSED,         // seq : PDU retransmis, value : taux de perte en %
+   TRACE_CWND_REDUCED,         // seq : PDU à l'origine de la réduction, value : fenêtre en centièmes de PDU
+   TRACE_ESTABLISHED,          // seq : prochain PDU à émettre, ack : prochain PDU attendu, value : port distant
+   TRACE_CLOSED,               // seq : prochain PDU à émettre, ack : prochain PDU attendu, value : état
+   TRACE_IP_DROPPED,           // seq, ack : en-tête du PDU perdu par la couche IP simulée, value : taille
+   TRACE_DEADLINE_EXPIRED,     // seq : PDU abandonné, ack : base de la fenêtre, value : retard sur l'échéance en µs
+   TRACE_FORWARD_SENT,         // seq : base annoncée, value : numéro d'envoi du FORWARD
+   TRACE_FORWARD_RECEIVED,     // seq : base annoncée, ack : prochain PDU attendu avant réception, value : avancée du puits
+   TRACE_TYPE_COUNT
+} trace_type;
+
+typedef struct trace_event
+{
+   uint64_t time;              // get_now_time_usec() (horloge monotone)
+   uint32_t seq;
+   uint32_t ack;
+   uint32_t value;
+   uint16_t socket;            // Descripteur MIC-TCP (0xffff hors socket)
+   uint8_t type;               // trace_type
+   uint8_t flags;              // Réservé
+} trace_event;
+
+typedef struct trace_ring
+{
+   uint64_t head;              // Nombre d'événements écrits (publié après chaque écriture)
+   uint32_t tid;               // Identifiant noyau du thread
+   uint32_t reserved;
+   trace_event events[TRACE_RING_EVENTS];
+} trace_ring;
+
+typedef struct trace_header
+{
+   uint32_t magic;
+   uint32_t version;
+   uint32_t max_threads;
+   uint32_t ring_events;
+   uint32_t event_size;
+   uint32_t threads;           // Anneaux attribués
+   uint64_t start_time;        // get_now_time_usec() à l'ouverture
+   uint32_t pid;
+   uint32_t reserved[7];
+} trace_header;
+
+#define TRACE_NO_SOCKET 0xffff
+
+extern trace_header* trace_file;
+
+int trace_open(const char* path);
+void trace_record(trace_type type, int socket, uint32_t seq, uint32_t ack, uint32_t value);
+const char* trace_type_name(int type);
+
+#if MIC_TCP_TRACE
+#define TRACE(type, socket, seq, ack, value) \
+   do { if (trace_file != NULL) trace_record(type, socket, seq, ack, value); } while (0)
+#else
+#define TRACE(type, socket, seq, ack, value) do { } while (0)
+#endif
+
+#endif
@@ -1,5 +1,16 @@
+/* recvmmsg() and sendmmsg() */
+#define _GNU_SOURCE
+
 #include <api/mictcp_core.h>
+#include <api/mictcp_ring.h>
+#include <api/mictcp_pool.h>
+#include <mictcp_log.h>
+#include <mictcp_trace.h>
+#include <netinet/udp.h>
+#include <sched.h>
 #include <sys/time.h>
+#include <stdint.h>
+#include <errno.h>
 #include <sys/queue.h>
 #include <math.h>
 #include <time.h>
@@ -11,44 +22,110 @@
  *****************/
 int initialized = -1;
 int sys_socket;
-pthread_t listen_th;
-pthread_mutex_t lock;
+pthread_t listen_th[MIC_TCP_MAX_WORKERS];
+pthread_mutex_t init_lock = PTHREAD_MUTEX_INITIALIZER;
 unsigned short  loss_rate = 0;
 struct sockaddr_in remote_addr;
 
-/* This is for the buffer */
-TAILQ_HEAD(tailhead, app_buffer_entry) app_buffer_head;
-struct tailhead *headp;
-struct app_buffer_entry {
-     mic_tcp_payload bf;
-     TAILQ_ENTRY(app_buffer_entry) entries;
-};
-
-/* Condition variable used for passive wait when buffer is empty */
-pthread_cond_t buffer_empty_cond;
+/* Server receive workers: one SO_REUSEPORT socket and one pinned receive
+   thread each, sys_socket is the first one. The kernel hashes the UDP 4-tuple,
+   so a connection (its own UDP source port) always lands on the same worker.
+   Workers still share the demux table lock and the socket mutexes */
+static unsigned int workers = 1;
+static int worker_sockets[MIC_TCP_MAX_WORKERS];
+static __thread int worker_socket = -1;
+
+/* This is for the buffers: one receive ring per MIC-TCP socket, filled by
+   the receive thread and emptied by the application (see mictcp_ring.h) */
+spsc_ring app_buffers[MAX_SOCKETS];
+
+/* Batched I/O: the receive thread reads up to batch_size datagrams per
+   recvmmsg() and queues what it sends while processing them, the queue is
+   flushed with a single sendmmsg() at the end of the batch. Other threads
+   can queue their sends the same way between IP_batch_begin() and
+   IP_batch_end() */
+static unsigned int batch_size = MIC_TCP_BATCH_DEFAULT;
+static __thread int tx_batching = 0;
+
+/* UDP offload (Linux >= 5.0): queued PDUs of the same size go out as one
+   GSO super-datagram, and the receive thread reads GRO super-datagrams */
+static int offload = 0;
+
+typedef struct tx_entry
+{
+    mic_tcp_header header;
+    pool_buf* payload; /* payload (reference or copy), NULL when empty */
+    int payload_size;
+    struct sockaddr_in dest;
+} tx_entry;
+static __thread tx_entry tx_queue[MIC_TCP_BATCH_MAX];
+static __thread int tx_count = 0;
+
+/* Statistics, updated with atomic operations */
+static unsigned long recv_calls;
+static unsigned long recv_datagrams;
+static unsigned long max_recv_batch;
+static unsigned long send_calls;
+static unsigned long send_datagrams;
+static unsigned long gso_sends;
+static unsigned long gro_recvs;
 
 /*************************
  * Fonctions Utilitaires *
  *************************/
+/* Socket of the calling thread: a receive worker sends and receives on its
+   own socket, every other thread uses the first one (same local port) */
+static int local_socket(void)
+{
+    return worker_socket != -1 ? worker_socket : sys_socket;
+}
+
+/* SO_RCVTIMEO last set by this thread and on which socket: only the receiving
+   thread of a socket reads it, and a socket starts without timeout (0) */
+static __thread int rcvtimeo_socket = -1;
+static __thread unsigned long rcvtimeo = 0;
+
+/* Open and bind the SO_REUSEPORT sockets of the server workers */
+static int open_workers(struct sockaddr_in* local_addr)
+{
+    int one = 1;
+    worker_sockets[0] = sys_socket;
+    for (unsigned int i = 0; i < workers; i++) {
+        if (i > 0 && (worker_sockets[i] = socket(AF_INET, SOCK_DGRAM, 0)) == -1) return -1;
+        if (workers > 1 && setsockopt(worker_sockets[i], SOL_SOCKET, SO_REUSEPORT, &one, sizeof(one)) == -1) return -1;
+        if (bind(worker_sockets[i], (struct sockaddr *) local_addr, sizeof(*local_addr)) == -1) return -1;
+    }
+    /* No steering program: the MIC-TCP source port is not spread (every client
+       process starts at EPHEMERAL_PORT_MIN), the kernel 4-tuple hash is */
+    return 0;
+}
+
 int initialize_components(start_mode mode)
 {
     int bnd;
     struct hostent * hp;
     struct sockaddr_in local_addr;
 
-    if(initialized != -1) return initialized;
-    if((sys_socket = socket(AF_INET, SOCK_DGRAM, 0)) == -1) return -1;
+    /* Several threads may create their first socket at the same time */
+    pthread_mutex_lock(&init_lock);
+    if(initialized != -1) {
+        pthread_mutex_unlock(&init_lock);
+        return initialized;
+    }
+    if((sys_socket = socket(AF_INET, SOCK_DGRAM, 0)) == -1) {
+        pthread_mutex_unlock(&init_lock);
+        return -1;
+    }
     else initialized = 1;
 
+
     if((mode == SERVER) & (initialized != -1))
     {
-        TAILQ_INIT(&app_buffer_head);
-        pthread_cond_init(&buffer_empty_cond, 0);
         memset((char *) &local_addr, 0, sizeof(local_addr));
         local_addr.sin_family = AF_INET;
         local_addr.sin_port = htons(API_CS_Port);
         local_addr.sin_addr.s_addr = htonl(INADDR_ANY);
-        bnd = bind(sys_socket, (struct sockaddr *) &local_addr, sizeof(local_addr));
+        bnd = open_workers(&local_addr);
 
         if (bnd == -1)
         {
@@ -76,46 +153,248 @@ int initialize_components(start_mode mode)
             hp = gethostbyname("localhost");
             memcpy (&(remote_addr.sin_addr.s_addr), hp->h_addr, hp->h_length);
 
+            /* Ephemeral UDP port: several client processes can run on the
+               same host, the server replies to the source of each packet */
             memset((char *) &local_addr, 0, sizeof(local_addr));
             local_addr.sin_family = AF_INET;
-            local_addr.sin_port = htons(API_SC_Port);
+            local_addr.sin_port = htons(0);
             local_addr.sin_addr.s_addr = htonl(INADDR_ANY);
             bnd = bind(sys_socket, (struct sockaddr *) &local_addr, sizeof(local_addr));
         }
     }
 
-    if((initialized == 1) && (mode == SERVER))
+    /* A single receive thread in both modes: ACKs and data are all
+       dispatched by process_received_PDU() */
+    if(initialized == 1)
     {
-        pthread_create (&listen_th, NULL, listening, "1");
+        unsigned int nb_threads = mode == SERVER ? workers : 1;
+        if (mode != SERVER) workers = 1;
+        for (unsigned int i = 0; i < nb_threads; i++) {
+            pthread_create (&listen_th[i], NULL, listening, (void*) (intptr_t) i);
+        }
     }
 
+    pthread_mutex_unlock(&init_lock);
     return initialized;
 }
 
 
 
-int IP_send(mic_tcp_pdu pk, mic_tcp_ip_addr addr)
+/* Resolve a host name to an IPv4 address */
+static int resolve_host(const char* host, struct in_addr* result)
+{
+    static __thread char cached_host[256] = "";
+    static __thread struct in_addr cached_addr;
+    struct addrinfo hints, *res;
+
+    if (inet_pton(AF_INET, host, result) == 1) return 0;
+    if (strcmp(host, cached_host) == 0) {
+        *result = cached_addr;
+        return 0;
+    }
+
+    memset(&hints, 0, sizeof(hints));
+    hints.ai_family = AF_INET;
+    hints.ai_socktype = SOCK_DGRAM;
+    if (getaddrinfo(host, NULL, &hints, &res) != 0) return -1;
+    *result = ((struct sockaddr_in *) res->ai_addr)->sin_addr;
+    freeaddrinfo(res);
+
+    strncpy(cached_host, host, sizeof(cached_host) - 1);
+    cached_addr = *result;
+    return 0;
+}
+
+/* Resolve an address "host" or "host:port" to an IPv4 socket address, thread safe.
+   Without a port, the default remote UDP port of the mode is used.
+   Numeric addresses are parsed directly, names go through getaddrinfo()
+   and the last one resolved by the calling thread is cached */
+int IP_resolve(const char* addr, struct sockaddr_in* result)
+{
+    char host[256];
+    const char* colon = strrchr(addr, ':');
+    size_t host_len = colon != NULL ? (size_t) (colon - addr) : strlen(addr);
+    if (host_len >= sizeof(host)) return -1;
+    memcpy(host, addr, host_len);
+    host[host_len] = '\0';
+
+    *result = remote_addr;
+    if (colon != NULL) result->sin_port = htons(atoi(colon + 1));
+    return resolve_host(host, &result->sin_addr);
+}
+
+/* Two queued PDUs can share a GSO super-datagram */
+static int same_dest(struct sockaddr_in* a, struct sockaddr_in* b)
+{
+    return a->sin_addr.s_addr == b->sin_addr.s_addr && a->sin_port == b->sin_port;
+}
+
+/* Send every queued datagram with as few sendmmsg() calls as possible */
+static void IP_flush(void)
+{
+    struct mmsghdr msgs[MIC_TCP_BATCH_MAX];
+    struct iovec iov[2 * MIC_TCP_BATCH_MAX];
+    union {
+        char buf[CMSG_SPACE(sizeof(uint16_t))];
+        struct cmsghdr align;
+    } ctrl[MIC_TCP_BATCH_MAX];
+    int segments[MIC_TCP_BATCH_MAX];
+    int gso = __atomic_load_n(&offload, __ATOMIC_RELAXED);
+    int i = 0, n = 0, v = 0, sent = 0;
+
+    if (tx_count == 0) return;
+    memset(msgs, 0, tx_count * sizeof(struct mmsghdr));
+    while (i < tx_count) {
+        /* With GSO, consecutive PDUs of the same size for the same destination
+           are sent as one datagram that the kernel splits, only the last one
+           may be shorter. The PDUs stay where they are, one iovec each part */
+        struct msghdr* hdr = &msgs[n].msg_hdr;
+        int first = i;
+        int seg_size = API_HD_Size + tx_queue[i].payload_size;
+        int total = 0;
+
+        hdr->msg_name = &tx_queue[i].dest;
+        hdr->msg_namelen = sizeof(struct sockaddr_in);
+        hdr->msg_iov = &iov[v];
+        do {
+            iov[v].iov_base = &tx_queue[i].header;
+            iov[v++].iov_len = API_HD_Size;
+            if (tx_queue[i].payload_size > 0) {
+                iov[v].iov_base = tx_queue[i].payload->data;
+                iov[v++].iov_len = tx_queue[i].payload_size;
+            }
+            total += API_HD_Size + tx_queue[i].payload_size;
+            i++;
+        } while (gso && i < tx_count && i - first < IP_GSO_MAX_SEGMENTS
+                 && API_HD_Size + tx_queue[i - 1].payload_size == seg_size
+                 && API_HD_Size + tx_queue[i].payload_size <= seg_size
+                 && total + API_HD_Size + tx_queue[i].payload_size <= IP_GSO_MAX_BYTES
+                 && same_dest(&tx_queue[i].dest, &tx_queue[first].dest));
+        hdr->msg_iovlen = &iov[v] - hdr->msg_iov;
+
+        segments[n] = i - first;
+        if (segments[n] > 1) {
+            struct cmsghdr* cm;
+            hdr->msg_control = ctrl[n].buf;
+            hdr->msg_controllen = sizeof(ctrl[n].buf);
+            cm = CMSG_FIRSTHDR(hdr);
+            cm->cmsg_level = SOL_UDP;
+            cm->cmsg_type = UDP_SEGMENT;
+            cm->cmsg_len = CMSG_LEN(sizeof(uint16_t));
+            *((uint16_t *) CMSG_DATA(cm)) = seg_size;
+        }
+        n++;
+    }
+
+    /* sendmmsg() may stop early, the datagram it failed on is dropped */
+    while (sent < n) {
+        int result = sendmmsg(local_socket(), msgs + sent, n - sent, 0);
+        __atomic_add_fetch(&send_calls, 1, __ATOMIC_RELAXED);
+        if (result <= 0) {
+            if (segments[sent] > 1 && errno == EIO) {
+                /* The output device cannot segment, back to one PDU per datagram */
+                LOG_INFO("[MICTCP-CORE] GSO indisponible, envoi paquet par paquet\n");
+                __atomic_store_n(&offload, 0, __ATOMIC_RELAXED);
+            }
+            sent++;
+            continue;
+        }
+        for (i = sent; i < sent + result; i++) {
+            __atomic_add_fetch(&send_datagrams, segments[i], __ATOMIC_RELAXED);
+            if (segments[i] > 1) __atomic_add_fetch(&gso_sends, 1, __ATOMIC_RELAXED);
+        }
+        sent += result;
+    }
+
+    for (i = 0; i < tx_count; i++) {
+        if (tx_queue[i].payload != NULL) pool_put(tx_queue[i].payload);
+    }
+    tx_count = 0;
+}
+
+/* Queue a PDU until the end of the current batch. A payload that starts a
+   pool buffer (pooled) is only referenced, the caller keeps it unchanged once sent;
+   any other payload is copied because the caller may reuse its memory as soon as IP_send() returns */
+static int IP_queue(mic_tcp_pdu* pk, struct sockaddr_in* dest, int pooled)
+{
+    tx_entry* entry;
+    int size = pk->payload.size > 0 ? pk->payload.size : 0;
+
+    if (size > POOL_BUF_SIZE) return -1;
+    if (tx_count == MIC_TCP_BATCH_MAX) IP_flush();
+
+    entry = &tx_queue[tx_count];
+    entry->payload = NULL;
+    if (size > 0 && pooled) {
+        entry->payload = pool_buf_of(pk->payload.data);
+        pool_ref(entry->payload);
+    } else if (size > 0) {
+        entry->payload = pool_alloc();
+        if (entry->payload == NULL) return -1;
+        memcpy(entry->payload->data, pk->payload.data, size);
+    }
+    entry->header = pk->header;
+    entry->payload_size = size;
+    entry->dest = *dest;
+    tx_count++;
+    return 0;
+}
+
+void IP_batch_begin(void)
+{
+    tx_batching++;
+}
+
+void IP_batch_end(void)
+{
+    /* Batches nest: only the outermost one flushes */
+    if (--tx_batching == 0) IP_flush();
+}
+
+/* Send a PDU, or queue it during a batch (pooled: see IP_queue()) */
+static int IP_send_pdu(mic_tcp_pdu pk, mic_tcp_ip_addr addr, int pooled)
 {
 
     int result = -1;
     int random = rand();
     int lr_tresh = (int) round(((float)loss_rate/100.0)*RAND_MAX);
-    struct hostent * hp;
+    /* Local copy of the destination: IP_send() can be called from several threads */
+    struct sockaddr_in dest_addr;
     if(initialized == -1) {
         result = -1;
 
+    } else if (IP_resolve(addr.addr, &dest_addr) == -1) {
+        LOG_ERROR("[MICTCP-CORE] Adresse inconnue : %s\n", addr.addr);
+        result = -1;
+
     } else {
-        mic_tcp_payload tmp = get_full_stream(pk);
-        int sent_size = tmp.size;
+        /* Gather the header and the payload straight from the caller's memory */
+        struct iovec iov[2];
+        struct msghdr msg;
+        iov[0].iov_base = &pk.header;
+        iov[0].iov_len = API_HD_Size;
+        iov[1].iov_base = pk.payload.data;
+        iov[1].iov_len = pk.payload.size > 0 ? pk.payload.size : 0;
+        memset(&msg, 0, sizeof(msg));
+        msg.msg_name = &dest_addr;
+        msg.msg_namelen = sizeof(dest_addr);
+        msg.msg_iov = iov;
+        msg.msg_iovlen = iov[1].iov_len > 0 ? 2 : 1;
+
+        int sent_size = API_HD_Size + iov[1].iov_len;
         if(random > lr_tresh) {
-            hp = gethostbyname(addr.addr);
-            memcpy (&(remote_addr.sin_addr.s_addr), hp->h_addr, hp->h_length);
-            sent_size = sendto(sys_socket, tmp.data, tmp.size, 0, (struct sockaddr *)&remote_addr, sizeof(struct sockaddr));
-            printf("[MICTCP-CORE] Envoi d'un paquet IP de taille %d vers l'adresse %s\n", sent_size, addr.addr);
+            if (!tx_batching || IP_queue(&pk, &dest_addr, pooled) == -1) {
+                sent_size = sendmsg(local_socket(), &msg, 0);
+                if (sent_size != -1) {
+                    __atomic_add_fetch(&send_calls, 1, __ATOMIC_RELAXED);
+                    __atomic_add_fetch(&send_datagrams, 1, __ATOMIC_RELAXED);
+                }
+            }
+            LOG_DEBUG("[MICTCP-CORE] Envoi d'un paquet IP de taille %d vers l'adresse %s\n", sent_size, addr.addr);
         } else {
-           printf("[MICTCP-CORE] Perte du paquet\n");
+           LOG_DEBUG("[MICTCP-CORE] Perte du paquet\n");
+           TRACE(TRACE_IP_DROPPED, TRACE_NO_SOCKET, pk.header.seq_num, pk.header.ack_num, pk.payload.size);
         }
-        free (tmp.data);
 
         /* Correct the sent size */
         result = (sent_size == -1) ? -1 : sent_size - API_HD_Size;
@@ -124,6 +403,34 @@ int IP_send(mic_tcp_pdu pk, mic_tcp_ip_addr addr)
     return result;
 }
 
+int IP_send(mic_tcp_pdu pk, mic_tcp_ip_addr addr)
+{
+    return IP_send_pdu(pk, addr, 0);
+}
+
+/* Same as IP_send() for a payload held at the start of a pool buffer:
+   a batch keeps a reference on the buffer instead of copying the payload */
+int IP_send_pooled(mic_tcp_pdu pk, mic_tcp_ip_addr addr)
+{
+    return IP_send_pdu(pk, addr, 1);
+}
+
+/* Fill in the addresses of a received datagram, the source as "ip:port" */
+static void set_recv_addr(struct sockaddr_in* from, mic_tcp_ip_addr* local_addr, mic_tcp_ip_addr* remote_addr)
+{
+    if (remote_addr != NULL) {
+        char ip[INET_ADDRSTRLEN];
+        inet_ntop(AF_INET, &(from->sin_addr), ip, sizeof(ip));
+        snprintf(remote_addr->addr, remote_addr->addr_size, "%s:%d", ip, ntohs(from->sin_port));
+        remote_addr->addr_size = strlen(remote_addr->addr) + 1; // don't forget '\0'
+    }
+
+    if (local_addr != NULL) {
+        local_addr->addr = "localhost";
+        local_addr->addr_size = strlen(local_addr->addr) + 1; // don't forget '\0'
+    }
+}
+
 int IP_recv(mic_tcp_pdu* pk, mic_tcp_ip_addr* local_addr, mic_tcp_ip_addr* remote_addr, unsigned long timeout)
 {
     int result = -1;
@@ -137,46 +444,58 @@ int IP_recv(mic_tcp_pdu* pk, mic_tcp_ip_addr* local_addr, mic_tcp_ip_addr* remot
         return -1;
     }
 
-    /* Compute the number of entire seconds */
-    tv.tv_sec = timeout / 1000;
-    /* Convert the remainder to microseconds */
-    tv.tv_usec = (timeout - tv.tv_sec * 1000) * 1000;
-
-    /* Create a reception buffer */
-    int buffer_size = API_HD_Size + pk->payload.size;
-    char *buffer = malloc(buffer_size);
-
-    if ((setsockopt(sys_socket, SOL_SOCKET, SO_RCVTIMEO, &tv, sizeof(tv))) >= 0) {
-       result = recvfrom(sys_socket, buffer, buffer_size, 0, (struct sockaddr *)&tmp_addr, &tmp_addr_size);
+    /* Scatter the header and the payload straight into the PDU */
+    struct iovec iov[2];
+    struct msghdr msg;
+    iov[0].iov_base = &pk->header;
+    iov[0].iov_len = API_HD_Size;
+    iov[1].iov_base = pk->payload.data;
+    iov[1].iov_len = pk->payload.size;
+    memset(&msg, 0, sizeof(msg));
+    msg.msg_name = &tmp_addr;
+    msg.msg_namelen = tmp_addr_size;
+    msg.msg_iov = iov;
+    msg.msg_iovlen = 2;
+
+    if (timeout == IP_NO_WAIT) {
+        /* Non blocking read, only returns what is already queued */
+        result = recvmsg(local_socket(), &msg, MSG_DONTWAIT);
+    } else {
+        /* Compute the number of entire seconds */
+        tv.tv_sec = timeout / 1000;
+        /* Convert the remainder to microseconds */
+        tv.tv_usec = (timeout - tv.tv_sec * 1000) * 1000;
+
+        /* The timeout is only set when it changes, not before every receive */
+        int sock = local_socket();
+        unsigned long current = sock == rcvtimeo_socket ? rcvtimeo : 0;
+        if (timeout == current || (setsockopt(sock, SOL_SOCKET, SO_RCVTIMEO, &tv, sizeof(tv))) >= 0) {
+           rcvtimeo_socket = sock;
+           rcvtimeo = timeout;
+           result = recvmsg(sock, &msg, 0);
+        }
     }
 
+    /* A datagram shorter than a header is not a PDU */
+    if (result != -1 && result < API_HD_Size) result = -1;
+
     if (result != -1) {
-        /* Create the mic_tcp_pdu */
-        memcpy (&(pk->header), buffer, API_HD_Size);
+        /* The mic_tcp_pdu is already filled in, only the size is left */
         pk->payload.size = result - API_HD_Size;
-        memcpy (pk->payload.data, buffer + API_HD_Size, pk->payload.size);
 
-        /* Generate a stub address */
-        if (remote_addr != NULL) {
-            inet_ntop(AF_INET, &(tmp_addr.sin_addr),remote_addr->addr,remote_addr->addr_size);
-            //remote_addr->addr = "localhost";
-            remote_addr->addr_size = strlen(remote_addr->addr) + 1; // don't forget '\0'
-        }
-
-        if (local_addr != NULL) {
-            local_addr->addr = "localhost";
-            local_addr->addr_size = strlen(local_addr->addr) + 1; // don't forget '\0'
-        }
+        /* Source address as "ip:port", IP_send() replies to this UDP port */
+        set_recv_addr(&tmp_addr, local_addr, remote_addr);
+        __atomic_add_fetch(&recv_calls, 1, __ATOMIC_RELAXED);
+        __atomic_add_fetch(&recv_datagrams, 1, __ATOMIC_RELAXED);
+        if (max_recv_batch == 0) __atomic_store_n(&max_recv_batch, 1, __ATOMIC_RELAXED);
 
-        printf("[MICTCP-CORE] Réception d'un paquet IP de taille %d provenant de %s\n", result, remote_addr->addr);
+        LOG_DEBUG("[MICTCP-CORE] Réception d'un paquet IP de taille %d provenant de %s\n", result, remote_addr->addr);
 
         /* Correct the receved size */
         result -= API_HD_Size;
 
     }
 
-    /* Free the reception buffer */
-    free(buffer);
 
     return result;
 }
@@ -214,72 +533,211 @@ mic_tcp_header get_mic_tcp_header(ip_payload packet)
 
 
 
-int app_buffer_get(mic_tcp_payload app_buff)
+int app_buffer_get(int queue, mic_tcp_payload app_buff, int wait)
 {
-    /* A pointer to a buffer entry */
-    struct app_buffer_entry * entry;
-
-    /* The actual size passed to the application */
-    int result = 0;
+    /* Waits without lock nor allocation, only when the ring is empty */
+    return ring_pop(&app_buffers[queue], app_buff.data, app_buff.size, wait);
+}
 
-    /* Lock a mutex to protect the buffer from corruption */
-    pthread_mutex_lock(&lock);
+int app_buffer_readable(int queue)
+{
+    return app_buffers[queue].slots != NULL && ring_readable(&app_buffers[queue]);
+}
 
-    /* If the buffer is empty, we wait for insertion */
-    while(app_buffer_head.tqh_first == NULL) {
-          pthread_cond_wait(&buffer_empty_cond, &lock);
-    }
+unsigned int app_buffer_depth(int queue)
+{
+    return app_buffers[queue].slots != NULL ? ring_depth(&app_buffers[queue]) : 0;
+}
 
-    /* When we execute the code below, the following conditions are true:
-       - The buffer contains at least 1 element
-       - We hold the lock on the mutex
-    */
+int app_buffer_put(int queue, mic_tcp_payload bf)
+{
+    /* Never blocks the receive thread: fails when the ring is full */
+    return ring_push(&app_buffers[queue], bf.data, bf.size);
+}
 
-    /* The entry we want is the first one in the buffer */
-    entry = app_buffer_head.tqh_first;
+int app_buffer_open(int queue)
+{
+    /* The ring memory and its eventfd are kept when a descriptor is reused */
+    if (app_buffers[queue].slots == NULL) return ring_init(&app_buffers[queue]);
+    ring_reset(&app_buffers[queue]);
+    return 0;
+}
 
-    /* How much data are we going to deliver to the application ? */
-    result = min_size(entry->bf.size, app_buff.size);
+void app_buffer_close(int queue)
+{
+    /* Readers blocked in app_buffer_get() return -1 */
+    if (app_buffers[queue].slots != NULL) ring_close(&app_buffers[queue]);
+}
 
-    /* We copy the actual data in the application allocated buffer */
-    memcpy(app_buff.data, entry->bf.data, result);
 
-    /* We remove the entry from the buffer */
-    TAILQ_REMOVE(&app_buffer_head, entry, entries);
 
-    /* Release the mutex */
-    pthread_mutex_unlock(&lock);
+int IP_set_batch_size(unsigned int size)
+{
+    if (size < 1 || size > MIC_TCP_BATCH_MAX) return -1;
+    __atomic_store_n(&batch_size, size, __ATOMIC_RELAXED);
+    return 0;
+}
 
-    /* Clean up memory */
-    free(entry->bf.data);
-    free(entry);
+int IP_set_offload(int enable)
+{
+    int value = enable ? 1 : 0;
 
-    return result;
+    if (initialized == -1) return -1;
+    /* GRO is enabled on the receiving sockets, GSO is chosen per send */
+    for (unsigned int i = 0; i < workers; i++) {
+        int sock = i == 0 ? sys_socket : worker_sockets[i];
+        if (setsockopt(sock, SOL_UDP, UDP_GRO, &value, sizeof(value)) == -1) return -1;
+    }
+    __atomic_store_n(&offload, value, __ATOMIC_RELAXED);
+    return 0;
 }
 
-void app_buffer_put(mic_tcp_payload bf)
+int IP_set_workers(unsigned int count)
 {
-    /* Prepare a buffer entry to store the data */
-    struct app_buffer_entry * entry = malloc(sizeof(struct app_buffer_entry));
-    entry->bf.size = bf.size;
-    entry->bf.data = malloc(bf.size);
-    memcpy(entry->bf.data, bf.data, bf.size);
-
-    /* Lock a mutex to protect the buffer from corruption */
-    pthread_mutex_lock(&lock);
+    /* The sockets are opened with the first MIC-TCP socket */
+    if (count < 1 || count > MIC_TCP_MAX_WORKERS || initialized != -1) return -1;
+    workers = count;
+    return 0;
+}
 
-    /* Insert the packet in the buffer, at the end of it */
-    TAILQ_INSERT_TAIL(&app_buffer_head, entry, entries);
+void IP_get_io_stats(mic_tcp_io_stats* stats)
+{
+    stats->batch_size = __atomic_load_n(&batch_size, __ATOMIC_RELAXED);
+    stats->recv_calls = __atomic_load_n(&recv_calls, __ATOMIC_RELAXED);
+    stats->recv_datagrams = __atomic_load_n(&recv_datagrams, __ATOMIC_RELAXED);
+    stats->max_recv_batch = __atomic_load_n(&max_recv_batch, __ATOMIC_RELAXED);
+    stats->send_calls = __atomic_load_n(&send_calls, __ATOMIC_RELAXED);
+    stats->send_datagrams = __atomic_load_n(&send_datagrams, __ATOMIC_RELAXED);
+    stats->offload = __atomic_load_n(&offload, __ATOMIC_RELAXED);
+    stats->gso_sends = __atomic_load_n(&gso_sends, __ATOMIC_RELAXED);
+    stats->gro_recvs = __atomic_load_n(&gro_recvs, __ATOMIC_RELAXED);
+    stats->workers = workers;
+}
 
-    /* Release the mutex */
-    pthread_mutex_unlock(&lock);
+/* Receive up to `count` datagrams with one recvmmsg() into the pool buffers
+   and process them, the replies are flushed together at the end */
+static void receive_batch(pool_buf** bufs, int count)
+{
+    mic_tcp_pdu pdus[MIC_TCP_BATCH_MAX];
+    struct mmsghdr msgs[MIC_TCP_BATCH_MAX];
+    struct iovec iov[MIC_TCP_BATCH_MAX][2];
+    struct sockaddr_in from[MIC_TCP_BATCH_MAX];
+    mic_tcp_ip_addr remote;
+    mic_tcp_ip_addr local;
+    char remote_buffer[IP_ADDR_SIZE];
+    int i, received;
+
+    memset(msgs, 0, count * sizeof(struct mmsghdr));
+    for (i = 0; i < count; i++) {
+        iov[i][0].iov_base = &pdus[i].header;
+        iov[i][0].iov_len = API_HD_Size;
+        iov[i][1].iov_base = bufs[i]->data;
+        iov[i][1].iov_len = POOL_BUF_SIZE - API_HD_Size;
+        msgs[i].msg_hdr.msg_name = &from[i];
+        msgs[i].msg_hdr.msg_namelen = sizeof(struct sockaddr_in);
+        msgs[i].msg_hdr.msg_iov = iov[i];
+        msgs[i].msg_hdr.msg_iovlen = 2;
+    }
 
-    /* We can now signal to any potential thread waiting that the buffer is
-       no longer empty */
-    pthread_cond_broadcast(&buffer_empty_cond);
+    /* Blocks for the first datagram only, then takes what is already queued */
+    received = recvmmsg(local_socket(), msgs, count, MSG_WAITFORONE, NULL);
+    if (received <= 0) {
+        /* This should never happen */
+        LOG_ERROR("Error in recv\n");
+        return;
+    }
+    __atomic_add_fetch(&recv_calls, 1, __ATOMIC_RELAXED);
+    __atomic_add_fetch(&recv_datagrams, received, __ATOMIC_RELAXED);
+    if ((unsigned long) received > max_recv_batch) __atomic_store_n(&max_recv_batch, received, __ATOMIC_RELAXED);
+
+    remote.addr = remote_buffer;
+    IP_batch_begin();
+    for (i = 0; i < received; i++) {
+        /* A datagram shorter than a header is not a PDU */
+        if (msgs[i].msg_len < API_HD_Size) continue;
+        pdus[i].payload.data = bufs[i]->data;
+        pdus[i].payload.size = msgs[i].msg_len - API_HD_Size;
+        remote.addr_size = IP_ADDR_SIZE;
+        set_recv_addr(&from[i], &local, &remote);
+        LOG_DEBUG("[MICTCP-CORE] Réception d'un paquet IP de taille %d provenant de %s\n", msgs[i].msg_len, remote.addr);
+        process_received_PDU(pdus[i], local, remote);
+    }
+    IP_batch_end();
 }
 
+/* With GRO, receive up to `count` super-datagrams and split each one back
+   into PDUs of gso_size bytes, copied into pool buffers for processing */
+static void receive_gro(char** supers, int count)
+{
+    struct mmsghdr msgs[IP_GRO_BUFFERS];
+    struct iovec iov[IP_GRO_BUFFERS];
+    struct sockaddr_in from[IP_GRO_BUFFERS];
+    union {
+        char buf[CMSG_SPACE(sizeof(int))];
+        struct cmsghdr align;
+    } ctrl[IP_GRO_BUFFERS];
+    mic_tcp_pdu pdu;
+    mic_tcp_ip_addr remote;
+    mic_tcp_ip_addr local;
+    char remote_buffer[IP_ADDR_SIZE];
+    int i, received;
+
+    memset(msgs, 0, count * sizeof(struct mmsghdr));
+    for (i = 0; i < count; i++) {
+        iov[i].iov_base = supers[i];
+        iov[i].iov_len = IP_GRO_BUFFER_SIZE;
+        msgs[i].msg_hdr.msg_name = &from[i];
+        msgs[i].msg_hdr.msg_namelen = sizeof(struct sockaddr_in);
+        msgs[i].msg_hdr.msg_iov = &iov[i];
+        msgs[i].msg_hdr.msg_iovlen = 1;
+        msgs[i].msg_hdr.msg_control = ctrl[i].buf;
+        msgs[i].msg_hdr.msg_controllen = sizeof(ctrl[i].buf);
+    }
 
+    received = recvmmsg(local_socket(), msgs, count, MSG_WAITFORONE, NULL);
+    if (received <= 0) {
+        /* This should never happen */
+        LOG_ERROR("Error in recv\n");
+        return;
+    }
+    __atomic_add_fetch(&recv_calls, 1, __ATOMIC_RELAXED);
+    if ((unsigned long) received > max_recv_batch) __atomic_store_n(&max_recv_batch, received, __ATOMIC_RELAXED);
+
+    remote.addr = remote_buffer;
+    IP_batch_begin();
+    for (i = 0; i < received; i++) {
+        struct cmsghdr* cm;
+        unsigned int len = msgs[i].msg_len;
+        unsigned int seg_size = len;
+        unsigned int offset;
+
+        /* Without the GRO control message the datagram holds a single PDU */
+        for (cm = CMSG_FIRSTHDR(&msgs[i].msg_hdr); cm != NULL; cm = CMSG_NXTHDR(&msgs[i].msg_hdr, cm)) {
+            if (cm->cmsg_level == SOL_UDP && cm->cmsg_type == UDP_GRO) seg_size = *((int *) CMSG_DATA(cm));
+        }
+        /* A segment must fit in a pool buffer, like on the non GRO path:
+           a larger datagram (GRO disabled by the sender, or not a PDU) is dropped */
+        if (seg_size < API_HD_Size || seg_size > API_HD_Size + POOL_BUF_SIZE) continue;
+        if (seg_size < len) __atomic_add_fetch(&gro_recvs, 1, __ATOMIC_RELAXED);
+
+        remote.addr_size = IP_ADDR_SIZE;
+        set_recv_addr(&from[i], &local, &remote);
+        for (offset = 0; offset + API_HD_Size <= len; offset += seg_size) {
+            unsigned int size = min_size(seg_size, len - offset);
+            pool_buf* buf = pool_alloc();
+            if (buf == NULL) break;
+            memcpy(&pdu.header, supers[i] + offset, API_HD_Size);
+            memcpy(buf->data, supers[i] + offset + API_HD_Size, size - API_HD_Size);
+            pdu.payload.data = buf->data;
+            pdu.payload.size = size - API_HD_Size;
+            __atomic_add_fetch(&recv_datagrams, 1, __ATOMIC_RELAXED);
+            LOG_DEBUG("[MICTCP-CORE] Réception d'un paquet IP de taille %d provenant de %s\n", size, remote.addr);
+            process_received_PDU(pdu, local, remote);
+            pool_put(buf);
+        }
+    }
+    IP_batch_end();
+}
 
 void* listening(void* arg)
 {
@@ -288,21 +746,58 @@ void* listening(void* arg)
     mic_tcp_ip_addr remote;
     mic_tcp_ip_addr local;
 
-    pthread_mutex_init(&lock, NULL);
-
-    printf("[MICTCP-CORE] Demarrage du thread de reception reseau...\n");
-
-    const int payload_size = 1500 - API_HD_Size;
-    pdu_tmp.payload.size = payload_size;
-    pdu_tmp.payload.data = malloc(payload_size);
-
-    remote.addr=malloc(100);
-    remote.addr_size=100;
+    LOG_INFO("[MICTCP-CORE] Demarrage du thread de reception reseau...\n");
+
+    /* A server worker reads its own socket on its own core */
+    int worker = (int) (intptr_t) arg;
+    if (workers > 1) {
+        cpu_set_t cpus;
+        long nb_cpus = sysconf(_SC_NPROCESSORS_ONLN);
+        worker_socket = worker_sockets[worker];
+        CPU_ZERO(&cpus);
+        CPU_SET(worker % (nb_cpus > 0 ? nb_cpus : 1), &cpus);
+        pthread_setaffinity_np(pthread_self(), sizeof(cpus), &cpus);
+    }
 
+    const int payload_size = POOL_BUF_SIZE - API_HD_Size;
+    char remote_buffer[IP_ADDR_SIZE];
+    remote.addr = remote_buffer;
+    char* supers[IP_GRO_BUFFERS] = { NULL };
 
     while(1)
     {
-        remote.addr_size=100;
+        int count = __atomic_load_n(&batch_size, __ATOMIC_RELAXED);
+
+        /* Super-datagrams do not fit in a pool buffer, the GRO buffers are
+           allocated the first time offload is enabled */
+        if (__atomic_load_n(&offload, __ATOMIC_RELAXED)) {
+            int i, n = min_size(count, IP_GRO_BUFFERS);
+            for (i = 0; i < n; i++) {
+                if (supers[i] == NULL) supers[i] = malloc(IP_GRO_BUFFER_SIZE);
+                if (supers[i] == NULL) break;
+            }
+            if (i > 0) receive_gro(supers, i);
+            continue;
+        }
+
+        /* Each PDU is received in its own pool buffer: process_received_PDU()
+           may keep a reference on it (pool_ref) instead of copying the data */
+        if (count > 1) {
+            pool_buf* bufs[MIC_TCP_BATCH_MAX];
+            int i, n = 0;
+            for (i = 0; i < count; i++) {
+                bufs[n] = pool_alloc();
+                if (bufs[n] != NULL) n++;
+            }
+            if (n > 0) receive_batch(bufs, n);
+            for (i = 0; i < n; i++) pool_put(bufs[i]);
+            continue;
+        }
+
+        pool_buf* buf = pool_alloc();
+        if (buf == NULL) continue;
+        remote.addr_size = IP_ADDR_SIZE;
+        pdu_tmp.payload.data = buf->data;
         pdu_tmp.payload.size = payload_size;
         recv_size = IP_recv(&pdu_tmp, &local, &remote, 0);
 
@@ -311,8 +806,9 @@ void* listening(void* arg)
             process_received_PDU(pdu_tmp, local, remote);
         } else {
             /* This should never happen */
-            printf("Error in recv\n");
+            LOG_ERROR("Error in recv\n");
         }
+        pool_put(buf);
     }
 }
 
@@ -336,7 +832,8 @@ unsigned long get_now_time_msec()
 unsigned long get_now_time_usec()
 {
     struct timespec now_time;
-    clock_gettime( CLOCK_REALTIME, &now_time);
+    /* Monotonic clock: timers and RTT samples must not jump with the wall clock */
+    clock_gettime( CLOCK_MONOTONIC, &now_time);
     return ((unsigned long)((now_time.tv_nsec / 1000) + (now_time.tv_sec * 1000000)));
 }
 
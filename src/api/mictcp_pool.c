@@ -0,0 +1,127 @@
+#include <api/mictcp_pool.h>
+
+/* Global free list, refilled and drained by batches of POOL_CACHE_SIZE / 2 */
+static pool_buf* arena;
+static pool_buf* free_list;
+static pthread_mutex_t pool_lock = PTHREAD_MUTEX_INITIALIZER;
+static pthread_once_t pool_once = PTHREAD_ONCE_INIT;
+static pthread_key_t cache_key;
+
+/* Statistics, updated with atomic operations */
+static unsigned long allocs;
+static unsigned long misses;
+static unsigned long in_use;
+static unsigned long high_watermark;
+
+/* Per-thread cache */
+struct pool_cache
+{
+  pool_buf* bufs[POOL_CACHE_SIZE];
+  int count;
+};
+static __thread struct pool_cache cache;
+
+static void cache_flush(struct pool_cache* c, int keep);
+
+/* Give the cache of an exiting thread back to the pool */
+static void cache_destructor(void* arg)
+{
+    cache_flush((struct pool_cache*) arg, 0);
+}
+
+static void pool_init(void)
+{
+    arena = malloc(POOL_SIZE * sizeof(pool_buf));
+    if (arena != NULL) {
+        for (int i = 0; i < POOL_SIZE; i++) {
+            arena[i].next = i + 1 < POOL_SIZE ? &arena[i + 1] : NULL;
+            arena[i].from_heap = 0;
+        }
+        free_list = arena;
+    }
+    pthread_key_create(&cache_key, cache_destructor);
+}
+
+/* Move cached buffers back to the global list, keeping `keep` of them */
+static void cache_flush(struct pool_cache* c, int keep)
+{
+    if (c->count <= keep) return;
+    pthread_mutex_lock(&pool_lock);
+    while (c->count > keep) {
+        pool_buf* buf = c->bufs[--c->count];
+        buf->next = free_list;
+        free_list = buf;
+    }
+    pthread_mutex_unlock(&pool_lock);
+}
+
+/* Take up to half a cache from the global list */
+static void cache_refill(struct pool_cache* c)
+{
+    pthread_mutex_lock(&pool_lock);
+    while (c->count < POOL_CACHE_SIZE / 2 && free_list != NULL) {
+        c->bufs[c->count++] = free_list;
+        free_list = free_list->next;
+    }
+    pthread_mutex_unlock(&pool_lock);
+}
+
+pool_buf* pool_alloc(void)
+{
+    pool_buf* buf;
+
+    pthread_once(&pool_once, pool_init);
+    if (cache.count == 0) {
+        /* First use by this thread: flush its cache when it exits */
+        if (pthread_getspecific(cache_key) == NULL) pthread_setspecific(cache_key, &cache);
+        cache_refill(&cache);
+    }
+
+    if (cache.count > 0) {
+        buf = cache.bufs[--cache.count];
+    } else {
+        /* Pool exhausted: fall back to the heap */
+        buf = malloc(sizeof(pool_buf));
+        if (buf == NULL) return NULL;
+        buf->from_heap = 1;
+        __atomic_add_fetch(&misses, 1, __ATOMIC_RELAXED);
+    }
+    buf->refcount = 1;
+    buf->next = NULL;
+
+    __atomic_add_fetch(&allocs, 1, __ATOMIC_RELAXED);
+    unsigned long used = __atomic_add_fetch(&in_use, 1, __ATOMIC_RELAXED);
+    unsigned long high = __atomic_load_n(&high_watermark, __ATOMIC_RELAXED);
+    while (used > high && !__atomic_compare_exchange_n(&high_watermark, &high, used, 1, __ATOMIC_RELAXED, __ATOMIC_RELAXED));
+    return buf;
+}
+
+void pool_ref(pool_buf* buf)
+{
+    __atomic_add_fetch(&buf->refcount, 1, __ATOMIC_RELAXED);
+}
+
+void pool_put(pool_buf* buf)
+{
+    if (buf == NULL) return;
+    if (__atomic_sub_fetch(&buf->refcount, 1, __ATOMIC_ACQ_REL) != 0) return;
+
+    __atomic_sub_fetch(&in_use, 1, __ATOMIC_RELAXED);
+    if (buf->from_heap) {
+        free(buf);
+        return;
+    }
+    /* The buffer goes to the cache of the thread releasing it */
+    if (cache.count == POOL_CACHE_SIZE) cache_flush(&cache, POOL_CACHE_SIZE / 2);
+    if (cache.count == 0 && pthread_getspecific(cache_key) == NULL) pthread_setspecific(cache_key, &cache);
+    cache.bufs[cache.count++] = buf;
+}
+
+void pool_get_stats(mic_tcp_pool_stats* stats)
+{
+    stats->capacity = POOL_SIZE;
+    stats->in_use = __atomic_load_n(&in_use, __ATOMIC_RELAXED);
+    stats->high_watermark = __atomic_load_n(&high_watermark, __ATOMIC_RELAXED);
+    stats->allocs = __atomic_load_n(&allocs, __ATOMIC_RELAXED);
+    stats->misses = __atomic_load_n(&misses, __ATOMIC_RELAXED);
+}
@@ -0,0 +1,138 @@
+#include <api/mictcp_ring.h>
+#include <api/mictcp_core.h>
+#include <sys/eventfd.h>
+#include <poll.h>
+#include <errno.h>
+
+/* Indexes only grow, the slot is index % RING_SIZE.
+   head is written by the consumer only, tail by the producer only. */
+
+int ring_init(spsc_ring* ring)
+{
+    memset(ring, 0, sizeof(spsc_ring));
+    ring->slots = malloc(RING_SIZE * sizeof(ring_slot));
+    if (ring->slots == NULL) return -1;
+    /* Non blocking: the consumer waits with poll(), a reset drains it */
+    ring->efd = eventfd(0, EFD_NONBLOCK);
+    if (ring->efd == -1) {
+        free(ring->slots);
+        ring->slots = NULL;
+        return -1;
+    }
+    return 0;
+}
+
+/* Empty a ring and reopen it, neither side may be using it */
+void ring_reset(spsc_ring* ring)
+{
+    uint64_t count;
+    ring->head = ring->cached_tail = 0;
+    ring->offset = 0;
+    ring->tail = ring->cached_head = 0;
+    ring->consumer_waiting = 0;
+    /* Drain a pending wakeup (fails with EAGAIN if there is none) */
+    if (read(ring->efd, &count, sizeof(count)) == -1) count = 0;
+    __atomic_store_n(&ring->closed, 0, __ATOMIC_SEQ_CST);
+}
+
+/* Wake up the consumer if it announced it may sleep */
+static void ring_wake(spsc_ring* ring)
+{
+    uint64_t one = 1;
+    if (__atomic_load_n(&ring->consumer_waiting, __ATOMIC_SEQ_CST)) {
+        if (write(ring->efd, &one, sizeof(one)) == -1) perror("[MICTCP-CORE] eventfd");
+    }
+}
+
+/* Copy a payload at the tail of the ring.
+   Returns 0, or -1 if the ring is full or closed (nothing is copied) */
+int ring_push(spsc_ring* ring, const char* data, int size)
+{
+    unsigned int tail = ring->tail;
+
+    if (__atomic_load_n(&ring->closed, __ATOMIC_RELAXED)) return -1;
+    if (tail - ring->cached_head >= RING_SIZE) {
+        ring->cached_head = __atomic_load_n(&ring->head, __ATOMIC_ACQUIRE);
+        if (tail - ring->cached_head >= RING_SIZE) return -1;
+    }
+
+    ring_slot* slot = &ring->slots[tail % RING_SIZE];
+    slot->size = min_size(size, RING_SLOT_SIZE);
+    memcpy(slot->data, data, slot->size);
+
+    /* Publish the slot, then check whether the consumer sleeps (seq_cst on
+       both sides: either it sees the new tail or we see its flag) */
+    __atomic_store_n(&ring->tail, tail + 1, __ATOMIC_SEQ_CST);
+    ring_wake(ring);
+    return 0;
+}
+
+/* Copy the payload at the head of the ring into data, waiting if the ring is
+   empty and `wait` is set. A payload larger than max_size is read over several
+   calls, the slot is only released once it is entirely read.
+   Returns the number of bytes copied, or -1 once the ring is closed and empty,
+   or -1 with errno set to EAGAIN if it is empty and `wait` is not set */
+int ring_pop(spsc_ring* ring, char* data, int max_size, int wait)
+{
+    unsigned int head = ring->head;
+    uint64_t count;
+    struct pollfd pfd = { ring->efd, POLLIN, 0 };
+
+    while (head == ring->cached_tail) {
+        ring->cached_tail = __atomic_load_n(&ring->tail, __ATOMIC_ACQUIRE);
+        if (head != ring->cached_tail) break;
+        if (!wait) {
+            errno = __atomic_load_n(&ring->closed, __ATOMIC_ACQUIRE) ? 0 : EAGAIN;
+            return -1;
+        }
+
+        /* Announce the sleep, then check again before blocking */
+        __atomic_store_n(&ring->consumer_waiting, 1, __ATOMIC_SEQ_CST);
+        ring->cached_tail = __atomic_load_n(&ring->tail, __ATOMIC_SEQ_CST);
+        if (head == ring->cached_tail) {
+            if (__atomic_load_n(&ring->closed, __ATOMIC_SEQ_CST)) {
+                __atomic_store_n(&ring->consumer_waiting, 0, __ATOMIC_RELAXED);
+                return -1;
+            }
+            if (poll(&pfd, 1, -1) == -1 && errno != EINTR) {
+                __atomic_store_n(&ring->consumer_waiting, 0, __ATOMIC_RELAXED);
+                return -1;
+            }
+            if (read(ring->efd, &count, sizeof(count)) == -1) count = 0;
+        }
+        __atomic_store_n(&ring->consumer_waiting, 0, __ATOMIC_RELAXED);
+    }
+
+    ring_slot* slot = &ring->slots[head % RING_SIZE];
+    int result = min_size(slot->size - ring->offset, max_size);
+    memcpy(data, slot->data + ring->offset, result);
+    ring->offset += result;
+    if (ring->offset < slot->size) return result;
+
+    /* Give the slot back to the producer */
+    ring->offset = 0;
+    __atomic_store_n(&ring->head, head + 1, __ATOMIC_RELEASE);
+    return result;
+}
+
+/* Whether a pop would not wait: data is queued or the ring is closed.
+   A hint only, from any thread */
+int ring_readable(spsc_ring* ring)
+{
+    return __atomic_load_n(&ring->tail, __ATOMIC_ACQUIRE) != __atomic_load_n(&ring->head, __ATOMIC_ACQUIRE)
+        || __atomic_load_n(&ring->closed, __ATOMIC_ACQUIRE);
+}
+
+/* Number of slots waiting for the consumer (approximate when read by another thread) */
+unsigned int ring_depth(spsc_ring* ring)
+{
+    return __atomic_load_n(&ring->tail, __ATOMIC_ACQUIRE) - __atomic_load_n(&ring->head, __ATOMIC_ACQUIRE);
+}
+
+/* Close the ring: pushes fail, the consumer returns -1 once the ring is empty */
+void ring_close(spsc_ring* ring)
+{
+    uint64_t one = 1;
+    __atomic_store_n(&ring->closed, 1, __ATOMIC_SEQ_CST);
+    if (write(ring->efd, &one, sizeof(one)) == -1) perror("[MICTCP-CORE] eventfd");
+}
@@ -0,0 +1,68 @@
+#include <mictcp_demux.h>
+#include <stdio.h>
+#include <time.h>
+
+/*
+ * Mesure du coût de démultiplexage d'un PDU en fonction du nombre de connexions :
+ * table de hachage (mictcp_demux.c) comparée au parcours linéaire de socket_list
+ * qu'utilisait process_received_PDU()
+ */
+
+#define LOOKUPS 2000000
+
+static demux_key_t keys[MAX_SOCKETS];
+
+static double now_sec(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+/* Ancienne recherche : parcours de toutes les connexions */
+static int linear_lookup(demux_key_t key, int nb_connections)
+{
+    for (int i = 0; i < nb_connections; i++) {
+        if (keys[i].local_port == key.local_port && keys[i].remote_ip == key.remote_ip
+            && keys[i].remote_udp_port == key.remote_udp_port && keys[i].remote_port == key.remote_port) return i;
+    }
+    return -1;
+}
+
+int main(int argc, char *argv[])
+{
+    const int sizes[] = { 1, 16, 64, 256, 1024 };
+    int inserted = 0;
+    volatile int sink = 0;
+
+    printf("%12s %16s %16s\n", "connexions", "hachage (ns)", "lineaire (ns)");
+    for (unsigned int s = 0; s < sizeof(sizes) / sizeof(sizes[0]); s++) {
+        int n = sizes[s];
+        if (n > MAX_SOCKETS) break;
+
+        /* Connexions vers un même port serveur, depuis des clients distincts */
+        for (; inserted < n; inserted++) {
+            keys[inserted].local_port = 9000;
+            keys[inserted].remote_ip = htonl(0x7F000001 + inserted / 64);
+            keys[inserted].remote_udp_port = htons(40000 + inserted);
+            keys[inserted].remote_port = EPHEMERAL_PORT_MIN + inserted;
+            if (demux_insert(keys[inserted], inserted) == -1) {
+                printf("Erreur d'insertion de la connexion %d\n", inserted);
+                return 1;
+            }
+        }
+
+        double start = now_sec();
+        for (int i = 0; i < LOOKUPS; i++) sink += demux_lookup(keys[(size_t) i * 7919 % n]);
+        double hash_ns = (now_sec() - start) * 1e9 / LOOKUPS;
+
+        start = now_sec();
+        for (int i = 0; i < LOOKUPS; i++) sink += linear_lookup(keys[(size_t) i * 7919 % n], n);
+        double linear_ns = (now_sec() - start) * 1e9 / LOOKUPS;
+
+        printf("%12d %16.1f %16.1f\n", n, hash_ns, linear_ns);
+    }
+    //? La table a une entrée par descripteur : au-delà de MAX_SOCKETS, la bibliothèque refuse la connexion
+    printf("(mesure limitée à MAX_SOCKETS = %d connexions, nombre maximum de sockets de la bibliothèque)\n", MAX_SOCKETS);
+    return sink == -1;
+}
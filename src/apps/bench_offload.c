@@ -0,0 +1,128 @@
+#include <mictcp.h>
+#include <api/mictcp_core.h>
+#include <stdio.h>
+#include <signal.h>
+#include <sys/wait.h>
+#include <time.h>
+
+/*
+ * Débit d'un transfert en masse sur la boucle locale, PDU par PDU puis avec
+ * la segmentation UDP par le noyau (GSO à l'envoi, GRO à la réception).
+ * Le serveur et le client de chaque mesure sont deux processus fils : la
+ * couche IP simulée n'a qu'une socket UDP par processus. Les pertes simulées
+ * sont désactivées pour mesurer le coût des entrées/sorties seul.
+ * Usage : bench_offload [nombre de messages] [port]
+ */
+
+#define MESSAGE_SIZE 1400
+
+typedef struct bench_result
+{
+    double seconds;
+    mic_tcp_io_stats io;
+} bench_result;
+
+static double now_sec(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+/* Puits : accepte une connexion et lit jusqu'à être tué par le parent */
+static void run_server(int port, int offload)
+{
+    char buffer[MESSAGE_SIZE];
+    mic_tcp_sock_addr addr, remote;
+    int sockfd, connfd;
+
+    addr.ip_addr.addr = "127.0.0.1";
+    addr.ip_addr.addr_size = strlen(addr.ip_addr.addr) + 1;
+    addr.port = port;
+
+    if ((sockfd = mic_tcp_socket(SERVER)) == -1) exit(1);
+    set_loss_rate(0);
+    if (offload && mic_tcp_set_offload(1) == -1) exit(1);
+    if (mic_tcp_bind(sockfd, addr) == -1) exit(1);
+    if ((connfd = mic_tcp_accept(sockfd, &remote)) == -1) exit(1);
+    while (mic_tcp_recv(connfd, buffer, sizeof(buffer)) >= 0);
+    exit(0);
+}
+
+/* Source : envoie les messages, attend leur acquittement et renvoie la mesure */
+static void run_client(int port, int offload, int messages, int result_fd)
+{
+    char buffer[MESSAGE_SIZE];
+    mic_tcp_sock_addr addr;
+    bench_result result;
+    int sockfd;
+
+    addr.ip_addr.addr = "127.0.0.1";
+    addr.ip_addr.addr_size = strlen(addr.ip_addr.addr) + 1;
+    addr.port = port;
+    memset(buffer, 'x', sizeof(buffer));
+
+    if ((sockfd = mic_tcp_socket(CLIENT)) == -1) exit(1);
+    set_loss_rate(0);
+    if (offload && mic_tcp_set_offload(1) == -1) exit(1);
+    if (mic_tcp_connect(sockfd, addr) == -1) exit(1);
+
+    double start = now_sec();
+    for (int i = 0; i < messages; i++) {
+        if (mic_tcp_send(sockfd, buffer, sizeof(buffer)) == -1) exit(1);
+    }
+    mic_tcp_close(sockfd); // Attend que la fenêtre d'émission soit vide
+    result.seconds = now_sec() - start;
+    mic_tcp_get_io_stats(&result.io);
+
+    if (write(result_fd, &result, sizeof(result)) != sizeof(result)) exit(1);
+    exit(0);
+}
+
+static int measure(int port, int offload, int messages, bench_result* result)
+{
+    int fds[2], status;
+    pid_t server, client;
+
+    if (pipe(fds) == -1) return -1;
+    fflush(stdout);
+
+    if ((server = fork()) == 0) {
+        /* Les traces de la bibliothèque fausseraient la mesure */
+        if (freopen("/dev/null", "w", stdout) == NULL) exit(1);
+        run_server(port, offload);
+    }
+    usleep(200000);
+    if ((client = fork()) == 0) {
+        if (freopen("/dev/null", "w", stdout) == NULL) exit(1);
+        run_client(port, offload, messages, fds[1]);
+    }
+    close(fds[1]);
+
+    int ok = read(fds[0], result, sizeof(*result)) == sizeof(*result);
+    close(fds[0]);
+    waitpid(client, &status, 0);
+    kill(server, SIGKILL);
+    waitpid(server, &status, 0);
+    return ok ? 0 : -1;
+}
+
+int main(int argc, char *argv[])
+{
+    int messages = argc > 1 ? atoi(argv[1]) : 50000;
+    int port = argc > 2 ? atoi(argv[2]) : 9100;
+    const char* modes[] = { "paquet", "GSO/GRO" };
+
+    printf("%10s %12s %14s %16s %12s\n", "mode", "debit (Mo/s)", "PDU/s", "envois (appels)", "super-dgr.");
+    for (int offload = 0; offload <= 1; offload++) {
+        bench_result result;
+        if (measure(port + offload, offload, messages, &result) == -1) {
+            printf("%10s %s\n", modes[offload], "echec (noyau sans UDP_SEGMENT/UDP_GRO ?)");
+            continue;
+        }
+        printf("%10s %12.1f %14.0f %16lu %12lu\n", modes[offload],
+               messages * (double) MESSAGE_SIZE / result.seconds / 1e6, messages / result.seconds,
+               result.io.send_calls, result.io.gso_sends);
+    }
+    return 0;
+}
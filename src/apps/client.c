@@ -45,6 +45,25 @@ int main(int argc, char *argv[])
         printf("D'autres message ?\n");
     }
 
+    mic_tcp_stats stats;
+    if (mic_tcp_get_stats(sockfd, &stats) == 0) {
+        printf("[TSOCK] RTT lisse : %lu us, variation : %lu us, RTO : %lu us (%u mesures, %u expirations)\n",
+               stats.srtt, stats.rttvar, stats.rto, stats.rtt_samples, stats.rto_expirations);
+    }
+
+    mic_tcp_pool_stats pool_stats;
+    if (mic_tcp_get_pool_stats(&pool_stats) == 0) {
+        printf("[TSOCK] Pool de tampons : %lu/%lu utilisés au maximum, %lu allocations, %lu hors pool\n",
+               pool_stats.high_watermark, pool_stats.capacity, pool_stats.allocs, pool_stats.misses);
+    }
+
+    mic_tcp_io_stats io_stats;
+    if (mic_tcp_get_io_stats(&io_stats) == 0) {
+        printf("[TSOCK] Lots de %u : %lu datagrammes recus en %lu appels (max %lu), %lu envoyes en %lu appels\n",
+               io_stats.batch_size, io_stats.recv_datagrams, io_stats.recv_calls, io_stats.max_recv_batch,
+               io_stats.send_datagrams, io_stats.send_calls);
+    }
+
     mic_tcp_close(sockfd);
 
     return 0;
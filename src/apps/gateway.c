@@ -61,8 +61,8 @@ enum gateway_protocol {
 //
 
 static void file_to_faketcp(char* filename, char *host, int port);
-static void file_to_mictcp(char* filename);
-static void mictcp_to_udp(char *host, int port);
+static void file_to_mictcp(char* filename, mic_tcp_cc_algo cc_algo, int loss_tolerance, long playout_delay);
+static void mictcp_to_udp(char *host, int port, int loss_tolerance);
 static int read_rtp_packet(FILE *fd, struct timespec *timestamp, char *buffer, int buffer_size);
 static struct timespec tsSubtract(struct timespec time1, struct timespec time2);
 static void usage(void);
@@ -75,10 +75,37 @@ int main(int argc, char** argv)
 {
     enum gateway_protocol proto = PROTO_TCP;
     enum gateway_function func = UND_FCT;
+    mic_tcp_cc_algo cc_algo = MIC_TCP_CC_RENO;
+    int loss_tolerance = -1; // -1 : tolérance par défaut de la bibliothèque
+    long playout_delay = 0; // Délai de lecture en µs (0 : fiabilité selon le taux de perte)
 
     int ch;
-    while ((ch = getopt(argc, argv, "t:sp")) != -1) {
+    while ((ch = getopt(argc, argv, "t:spc:l:d:")) != -1) {
         switch (ch) {
+        case 'c':
+            if (strcmp(optarg, "reno") == 0) {
+                cc_algo = MIC_TCP_CC_RENO;
+            } else if (strcmp(optarg, "cubic") == 0) {
+                cc_algo = MIC_TCP_CC_CUBIC;
+            } else {
+                printf("Unrecognized congestion control : %s\n", optarg);
+                usage();
+            }
+            break;
+        case 'l':
+            loss_tolerance = atoi(optarg);
+            if (loss_tolerance < 0 || loss_tolerance > 100) {
+                printf("Unrecognized loss tolerance : %s\n", optarg);
+                usage();
+            }
+            break;
+        case 'd':
+            playout_delay = atol(optarg) * 1000;
+            if (playout_delay <= 0) {
+                printf("Unrecognized playout delay : %s\n", optarg);
+                usage();
+            }
+            break;
         case 't':
             if (strcmp(optarg, "mictcp") == 0) {
                 proto = PROTO_MICTCP;
@@ -123,9 +150,9 @@ int main(int argc, char** argv)
         }
     } else {
         if (func == SOURCE) {
-            file_to_mictcp(VIDEO_FILE);
+            file_to_mictcp(VIDEO_FILE, cc_algo, loss_tolerance, playout_delay);
         } else {
-            mictcp_to_udp("127.0.0.1", atoi(argv[0]));
+            mictcp_to_udp("127.0.0.1", atoi(argv[0]), loss_tolerance);
         }
     }
     return 0;
@@ -140,7 +167,7 @@ int main(int argc, char** argv)
  */
 static void usage(void)
 {
-    printf("usage: gateway [-p|-s][-t tcp|mictcp] (<server>) <port>\n");
+    printf("usage: gateway [-p|-s][-t tcp|mictcp][-c reno|cubic][-l <loss %%>][-d <playout ms>] (<server>) <port>\n");
     exit(EXIT_FAILURE);
 }
 
@@ -205,10 +232,38 @@ static void file_to_faketcp(char* filename, char *host, int port)
     fclose(filefd);
 }
 
+/**
+ * Lit les complétions des envois asynchrones et les comptabilise,
+ * en attendant au plus timeout ms.
+ * Retourne le nombre de complétions lues.
+ */
+static int count_completions(int sockfd, int timeout, unsigned long *acked, unsigned long *abandoned)
+{
+    mic_tcp_completion done[MIC_TCP_CQ_SIZE];
+    int nb_done = mic_tcp_get_completions(sockfd, done, MIC_TCP_CQ_SIZE, timeout);
+    for (int i = 0; i < nb_done; i++) {
+        if (done[i].type == MIC_TCP_SEND_ACKED) (*acked)++;
+        else if (done[i].type == MIC_TCP_SEND_ABANDONED) (*abandoned)++;
+    }
+    return nb_done;
+}
+
+/**
+ * Return the monotonic clock in µs
+ */
+static long monotonic_usec(void)
+{
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return now.tv_sec * 1000000L + now.tv_nsec / 1000;
+}
+
 /**
  * Function that reads a file and delivers to MICTCP.
+ * With a playout delay, each RTP packet must be delivered before its playout time
+ * (first packet sent + timestamp offset + delay): MICTCP stops retransmitting it afterwards.
  */
-static void file_to_mictcp(char* filename)
+static void file_to_mictcp(char* filename, mic_tcp_cc_algo cc_algo, int loss_tolerance, long playout_delay)
 {
     /* Création du socket MICTCP */
     int sockfd = mic_tcp_socket(CLIENT);
@@ -216,6 +271,16 @@ static void file_to_mictcp(char* filename)
         printf("ERROR creating the MICTCP socket\n");
     }
 
+    /* Choix du contrôle de congestion */
+    if (mic_tcp_set_option(sockfd, MIC_TCP_CONGESTION, cc_algo) == -1) {
+        printf("ERROR setting the MICTCP congestion control\n");
+    }
+
+    /* Taux de perte proposé au puits, le plus strict des deux est retenu */
+    if (loss_tolerance >= 0 && mic_tcp_set_option(sockfd, MIC_TCP_LOSS_TOLERANCE, loss_tolerance) == -1) {
+        printf("ERROR setting the MICTCP loss tolerance\n");
+    }
+
     /* On effectue la connexion */
     mic_tcp_sock_addr dest_addr;
     dest_addr.ip_addr.addr = "localhost";
@@ -231,6 +296,10 @@ static void file_to_mictcp(char* filename)
 
     struct timespec current_time, last_time;    // stockage des timestamps
     char buffer[MAX_UDP_SEGMENT_SIZE];          // buffer de lecture/ecriture
+    unsigned long acked = 0, abandoned = 0;     // sort des paquets envoyés
+    unsigned long late = 0;                     // paquets déjà en retard sur leur lecture, jamais envoyés
+    struct timespec first_time;                 // timestamp du premier paquet
+    long start_usec = -1;                       // date d'envoi du premier paquet
     last_time.tv_sec = -1;
     last_time.tv_nsec = LONG_MAX;
 
@@ -247,13 +316,39 @@ static void file_to_mictcp(char* filename)
         /* Mise à jour du timestamp */
         last_time = current_time;
 
-        /* Envoi du paquet rtp via mictcp */
-        int nb_sent = mic_tcp_send(sockfd, buffer, nb_read);
-        if (nb_sent < 0) {
-            printf("ERROR on MICTCP send\n");
+        /* Echéance du paquet : sa date de lecture, déduite de son timestamp (0 : sans échéance) */
+        long lifetime = 0;
+        if (playout_delay > 0) {
+            if (start_usec < 0) {
+                start_usec = monotonic_usec();
+                first_time = current_time;
+            }
+            struct timespec offset = tsSubtract(current_time, first_time);
+            long playout = start_usec + offset.tv_sec * 1000000L + offset.tv_nsec / 1000 + playout_delay;
+            lifetime = playout - monotonic_usec();
+            if (lifetime <= 0) {
+                late++;
+                continue;
+            }
+        }
+
+        /* Envoi asynchrone du paquet rtp via mictcp : la lecture et le rythme
+           continuent pendant que les acquittements reviennent */
+        while (mic_tcp_send_async_deadline(sockfd, buffer, nb_read, NULL, lifetime) < 0) {
+            if (errno != EAGAIN) {
+                printf("ERROR on MICTCP send\n");
+                break;
+            }
+            /* Fenêtre d'émission pleine : attente du sort d'un paquet */
+            count_completions(sockfd, 10, &acked, &abandoned);
         }
+        count_completions(sockfd, 0, &acked, &abandoned);
     }
 
+    /* Attente du sort des derniers paquets (0 quand plus rien n'est en cours) */
+    while (count_completions(sockfd, -1, &acked, &abandoned) > 0);
+    printf("MICTCP: %lu paquets acquittes, %lu abandonnes, %lu en retard\n", acked, abandoned, late);
+
     /* Fermeture du socket et du fichier */
     if (mic_tcp_close(sockfd) == -1) {
         printf("ERROR on MICTCP close\n");
@@ -264,7 +359,7 @@ static void file_to_mictcp(char* filename)
 /**
  * Function that listens on MICTCP and delivers to UDP.
  */
-static void mictcp_to_udp(char *host, int port)
+static void mictcp_to_udp(char *host, int port, int loss_tolerance)
 {
     /* Création du socket UDP */
     int udp_sockfd = socket(AF_INET, SOCK_DGRAM, 0);
@@ -286,6 +381,11 @@ static void mictcp_to_udp(char *host, int port)
         printf("ERROR creating the MICTCP socket\n");
     }
 
+    /* Taux de perte maximal accepté par le puits, le plus strict des deux est retenu */
+    if (loss_tolerance >= 0 && mic_tcp_set_option(mictcp_sockfd, MIC_TCP_LOSS_TOLERANCE, loss_tolerance) == -1) {
+        printf("ERROR setting the MICTCP loss tolerance\n");
+    }
+
     /* On bind le socket mictcp à une adresse locale */
     mic_tcp_sock_addr mt_local_addr;
     mt_local_addr.ip_addr.addr = NULL;
@@ -297,14 +397,15 @@ static void mictcp_to_udp(char *host, int port)
 
     /* Acceptation d'une demande de connexion */
     mic_tcp_sock_addr mt_remote_addr;
-    if (mic_tcp_accept(mictcp_sockfd, &mt_remote_addr) == -1) {
+    int mictcp_connfd = mic_tcp_accept(mictcp_sockfd, &mt_remote_addr);
+    if (mictcp_connfd == -1) {
         printf("ERROR on accept on the MICTCP socket\n");
     }
 
     /* Lecture mictcp vers udp */
     char buff[MAX_UDP_SEGMENT_SIZE];    // buffer de lecture/ecriture
     while (1) {
-        int nb_read = mic_tcp_recv(mictcp_sockfd, buff, MAX_UDP_SEGMENT_SIZE);
+        int nb_read = mic_tcp_recv(mictcp_connfd, buff, MAX_UDP_SEGMENT_SIZE);
         if (nb_read <= 0) {
             if (nb_read < 0) {
                 printf("ERROR on mic_recv on the MICTCP socket\n");
@@ -317,7 +418,7 @@ static void mictcp_to_udp(char *host, int port)
     }
 
     /* Fermeture des sockets */
-    if (mic_tcp_close(mictcp_sockfd) == -1) {
+    if (mic_tcp_close(mictcp_connfd) == -1 || mic_tcp_close(mictcp_sockfd) == -1) {
         printf("ERROR on MICTCP close\n");
     }
     close(udp_sockfd);
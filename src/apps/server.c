@@ -1,19 +1,40 @@
 #include <mictcp.h>
 #include <stdio.h>
+#include <errno.h>
 
 #define MAX_SIZE 1000
 
+/* Lit tous les messages prêts d'une connexion non bloquante
+   Retourne -1 si la connexion est fermée */
+static int read_connection(int connfd)
+{
+    char chaine[MAX_SIZE];
+    int rcv_size;
+
+    memset(chaine, 0, MAX_SIZE);
+    while ((rcv_size = mic_tcp_recv(connfd, chaine, MAX_SIZE)) >= 0) {
+        printf("[TSOCK] Reception d'un message de taille : %d\n", rcv_size);
+        printf("[TSOCK] Message Recu : %s\n", chaine);
+    }
+    return errno == EAGAIN ? 0 : -1;
+}
+
 int main(int argc, char *argv[])
 {
     int sockfd;
     mic_tcp_sock_addr addr;
     mic_tcp_sock_addr remote_addr;
-    char chaine[MAX_SIZE];
 
     addr.ip_addr.addr = "127.0.0.1";
     addr.ip_addr.addr_size = strlen(addr.ip_addr.addr) + 1;
     addr.port = atoi(argv[1]);
 
+    /* Nombre optionnel de threads de réception, un par coeur */
+    if (argc > 2 && mic_tcp_set_workers(atoi(argv[2])) == -1)
+    {
+        printf("[TSOCK] Nombre de threads de reception invalide : %s\n", argv[2]);
+        return 1;
+    }
 
     if ((sockfd = mic_tcp_socket(SERVER)) == -1)
     {
@@ -35,27 +56,47 @@ int main(int argc, char *argv[])
         printf("[TSOCK] Bind du socket MICTCP: OK\n");
     }
 
-    if (mic_tcp_accept(sockfd, &remote_addr) == -1)
-    {
-        printf("[TSOCK] Erreur lors de l'accept sur le socket MICTCP!\n");
-        return 1;
-    }
-    else
-    {
-        printf("[TSOCK] Accept sur le socket MICTCP: OK\n");
-    }
+    printf("[TSOCK] Appuyez sur CTRL+C pour quitter ...\n");
 
+    /* Un seul thread sert toutes les connexions : le socket en écoute et les
+       connexions acceptées sont non bloquants et attendus avec mic_tcp_poll() */
+    mic_tcp_set_option(sockfd, MIC_TCP_NONBLOCK, 1);
+    mic_tcp_accept(sockfd, &remote_addr); /* Met le socket en écoute */
 
-    memset(chaine, 0, MAX_SIZE);
+    mic_tcp_pollfd fds[MAX_SOCKETS];
+    int nfds = 1;
+    fds[0].fd = sockfd;
+    fds[0].events = MIC_TCP_POLLIN;
 
-    printf("[TSOCK] Appuyez sur CTRL+C pour quitter ...\n");
+    while (1) {
+        if (mic_tcp_poll(fds, nfds, -1) == -1) {
+            printf("[TSOCK] Erreur lors de l'attente sur les sockets MICTCP!\n");
+            return 1;
+        }
 
-    while(1) {
-        int rcv_size = 0;
-        printf("[TSOCK] Attente d'une donnee, appel de mic_recv ...\n");
-        rcv_size = mic_tcp_recv(sockfd, chaine, MAX_SIZE);
-        printf("[TSOCK] Reception d'un message de taille : %d\n", rcv_size);
-        printf("[TSOCK] Message Recu : %s\n", chaine);
+        if (fds[0].revents & MIC_TCP_POLLIN) {
+            int connfd;
+            while ((connfd = mic_tcp_accept(sockfd, &remote_addr)) != -1) {
+                printf("[TSOCK] Accept sur le socket MICTCP: OK\n");
+                mic_tcp_set_option(connfd, MIC_TCP_NONBLOCK, 1);
+                if (nfds == MAX_SOCKETS) {
+                    mic_tcp_close(connfd);
+                    continue;
+                }
+                fds[nfds].fd = connfd;
+                fds[nfds].events = MIC_TCP_POLLIN;
+                fds[nfds].revents = 0;
+                nfds++;
+            }
+        }
+
+        for (int i = nfds - 1; i > 0; i--) {
+            if (fds[i].revents == 0) continue;
+            if ((fds[i].revents & MIC_TCP_POLLNVAL) || read_connection(fds[i].fd) == -1) {
+                mic_tcp_close(fds[i].fd);
+                fds[i] = fds[--nfds];
+            }
+        }
     }
     return 0;
 }
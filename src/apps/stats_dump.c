@@ -0,0 +1,69 @@
+#include <mictcp.h>
+#include <stdio.h>
+#include <fcntl.h>
+#include <sys/mman.h>
+
+/*
+ * Lecteur externe des statistiques publiées par mic_tcp_stats_export()
+ * Projette le segment en lecture seule et affiche les sockets utilisés,
+ * une fois ou toutes les intervalle ms. Aucun appel à la bibliothèque :
+ * les entrées sont lues sous seqlock (relues si une mise à jour est en cours)
+ * Usage : stats_dump <segment, par exemple /mictcp.1234> [intervalle ms]
+ */
+
+/* Copie cohérente d'une entrée, relue tant que le publieur l'écrit */
+static void read_entry(const mic_tcp_stats_entry* shared, mic_tcp_stats_entry* copy)
+{
+    unsigned int before, after;
+    do {
+        before = __atomic_load_n(&shared->sequence, __ATOMIC_ACQUIRE);
+        *copy = *shared;
+        __atomic_thread_fence(__ATOMIC_ACQUIRE);
+        after = __atomic_load_n(&shared->sequence, __ATOMIC_RELAXED);
+    } while ((before & 1) || before != after);
+}
+
+static void dump(const mic_tcp_stats_segment* segment)
+{
+    printf("# processus %u, publication n°%lu (toutes les %lu µs)\n", segment->pid, segment->updates, segment->period);
+    printf("%4s %6s %6s %5s %12s %9s %12s %8s %8s %8s %5s %6s %5s %8s %7s %5s %5s %5s\n", "fd", "local", "dist.", "etat",
+           "octets env.", "PDU env.", "octets recus", "retrans.", "abandons", "hors dél", "fwd", "perte%", "tol.%", "srtt(us)", "cwnd", "f.em", "f.ord", "f.app");
+    for (unsigned int fd = 0; fd < segment->max_sockets; fd++) {
+        mic_tcp_stats_entry entry;
+        read_entry(&segment->sockets[fd], &entry);
+        if (!entry.in_use) continue;
+        mic_tcp_stats* s = &entry.stats;
+        printf("%4u %6u %6u %5d %12lu %9lu %12lu %8lu %8lu %8lu %5u %6u %5u %8lu %7.1f %5u %5u %5u\n", fd, entry.local_port, entry.remote_port,
+               entry.state, s->bytes_sent, s->segments_sent, s->bytes_received, s->retransmissions, s->losses_accepted, s->deadline_drops,
+               s->forwards_sent, s->loss_rate, s->loss_tolerance, s->srtt, s->cwnd, s->send_queue, s->reorder_queue, s->recv_queue);
+    }
+    fflush(stdout);
+}
+
+int main(int argc, char *argv[])
+{
+    if (argc < 2) {
+        fprintf(stderr, "Usage : %s <segment> [intervalle ms]\n", argv[0]);
+        return 1;
+    }
+    int interval = argc > 2 ? atoi(argv[2]) : 0;
+
+    int fd = shm_open(argv[1], O_RDONLY, 0);
+    if (fd == -1) {
+        fprintf(stderr, "Segment introuvable : %s\n", argv[1]);
+        return 1;
+    }
+    mic_tcp_stats_segment* segment = mmap(NULL, sizeof(mic_tcp_stats_segment), PROT_READ, MAP_SHARED, fd, 0);
+    close(fd);
+    if (segment == MAP_FAILED || segment->magic != MIC_TCP_STATS_MAGIC || segment->version != MIC_TCP_STATS_VERSION
+        || segment->max_sockets != MAX_SOCKETS) {
+        fprintf(stderr, "Format de segment inconnu : %s\n", argv[1]);
+        return 1;
+    }
+
+    do {
+        dump(segment);
+        if (interval > 0) usleep(interval * 1000);
+    } while (interval > 0);
+    return 0;
+}
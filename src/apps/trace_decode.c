@@ -0,0 +1,92 @@
+#include <mictcp_trace.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+/*
+ * Décodeur hors ligne de la trace binaire de MIC-TCP (voir mictcp_trace.h)
+ * Fusionne les anneaux de tous les threads par date et affiche les événements
+ * en texte, ou en CSV avec -c. Les dates sont en µs depuis l'ouverture de la trace
+ * Usage : trace_decode [-c] <fichier de trace>
+ */
+
+typedef struct decoded_event
+{
+    trace_event event;
+    unsigned int thread;
+} decoded_event;
+
+static int by_time(const void* a, const void* b)
+{
+    const decoded_event* x = a;
+    const decoded_event* y = b;
+    if (x->event.time != y->event.time) return x->event.time < y->event.time ? -1 : 1;
+    return 0;
+}
+
+int main(int argc, char *argv[])
+{
+    int csv = argc > 2 && strcmp(argv[1], "-c") == 0;
+    if (argc < 2 || (argc > 2 && !csv)) {
+        fprintf(stderr, "Usage : %s [-c] <fichier de trace>\n", argv[0]);
+        return 1;
+    }
+    const char* path = argv[argc - 1];
+
+    int fd = open(path, O_RDONLY);
+    struct stat st;
+    if (fd == -1 || fstat(fd, &st) == -1 || (size_t) st.st_size < sizeof(trace_header)) {
+        fprintf(stderr, "Trace illisible : %s\n", path);
+        return 1;
+    }
+    trace_header* header = mmap(NULL, st.st_size, PROT_READ, MAP_SHARED, fd, 0);
+    close(fd);
+    if (header == MAP_FAILED) return 1;
+    if (header->magic != TRACE_MAGIC || header->version != TRACE_VERSION || header->event_size != sizeof(trace_event)
+        || header->ring_events != TRACE_RING_EVENTS
+        || (size_t) st.st_size < sizeof(trace_header) + header->max_threads * sizeof(trace_ring)) {
+        fprintf(stderr, "Format de trace inconnu : %s\n", path);
+        return 1;
+    }
+
+    //? Chaque anneau garde ses TRACE_RING_EVENTS derniers événements
+    unsigned int threads = header->threads < header->max_threads ? header->threads : header->max_threads;
+    trace_ring* rings = (trace_ring *) (header + 1);
+    decoded_event* events = malloc((size_t) threads * TRACE_RING_EVENTS * sizeof(decoded_event));
+    size_t count = 0, overwritten = 0;
+    if (events == NULL && threads > 0) return 1;
+    for (unsigned int t = 0; t < threads; t++) {
+        uint64_t head = __atomic_load_n(&rings[t].head, __ATOMIC_ACQUIRE);
+        uint64_t first = head > TRACE_RING_EVENTS ? head - TRACE_RING_EVENTS : 0;
+        overwritten += first;
+        for (uint64_t i = first; i < head; i++) {
+            events[count].event = rings[t].events[i & (TRACE_RING_EVENTS - 1)];
+            events[count].thread = rings[t].tid;
+            count++;
+        }
+    }
+    qsort(events, count, sizeof(decoded_event), by_time);
+
+    if (csv) {
+        printf("time_us,thread,socket,event,seq,ack,value\n");
+    } else {
+        printf("# processus %u, %u threads, %zu événements (%zu écrasés)\n", header->pid, threads, count, overwritten);
+        printf("%12s %8s %6s %-18s %10s %10s %10s\n", "date (µs)", "thread", "socket", "evenement", "seq", "ack", "valeur");
+    }
+    for (size_t i = 0; i < count; i++) {
+        trace_event* e = &events[i].event;
+        long long time = (long long) (e->time - header->start_time);
+        int socket = e->socket == TRACE_NO_SOCKET ? -1 : e->socket;
+        if (csv) {
+            printf("%lld,%u,%d,%s,%u,%u,%u\n", time, events[i].thread, socket, trace_type_name(e->type), e->seq, e->ack, e->value);
+        } else {
+            printf("%12lld %8u %6d %-18s %10u %10u %10u\n", time, events[i].thread, socket, trace_type_name(e->type), e->seq, e->ack, e->value);
+        }
+    }
+    free(events);
+    return 0;
+}
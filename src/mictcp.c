@@ -1,21 +1,77 @@
 #include <mictcp.h>
+#include <mictcp_cc.h>
+#include <mictcp_timer.h>
+#include <mictcp_demux.h>
+#include <mictcp_log.h>
+#include <mictcp_trace.h>
 #include <api/mictcp_core.h>
+#include <api/mictcp_pool.h>
+#include <stdint.h>
+#include <errno.h>
+#include <poll.h>
+#include <sys/eventfd.h>
+#include <sys/mman.h>
+#include <fcntl.h>
 
 //! Parametres globaux définis dans mictcp.h
 sliding_window_t loss_window[MAX_SOCKETS]; // Fenêtre glissante pour chaque socket
 int real_loss_rate = REAL_LOSS; // Taux de perte réel utilisé pour simuler les pertes
-// Taux de perte acceptables. Par défaut (20%)
-int acceptable_loss_rate =  DEFAULT_ACCEPTABLE_LOSS; // Utilisée pour négocier le taux de perte acceptable dans le SYN de connexion 
+// Taux de perte acceptable de chaque socket, en % (option MIC_TCP_LOSS_TOLERANCE, DEFAULT_ACCEPTABLE_LOSS par défaut).
+// Proposé par le client dans le SYN, le serveur retient le plus strict des deux et le renvoie dans le SYN-ACK
+int acceptable_loss_rate[MAX_SOCKETS];
 
 mic_tcp_sock socket_list[MAX_SOCKETS]; //Liste des sockets MIC-TCP 
-int last_used_socket = 0; // Dernier socket utilisé
+int last_used_socket = 0; // Nombre d'emplacements de socket_list déjà utilisés
+pthread_mutex_t socket_list_lock = PTHREAD_MUTEX_INITIALIZER; // Protège l'attribution des descripteurs
 int next_sequence[MAX_SOCKETS] = {0}; // Numéro de séquence du prochain PDU à émettre
+int expected_sequence[MAX_SOCKETS] = {0}; // Numéro de séquence du prochain PDU attendu
+char remote_ip[MAX_SOCKETS][IP_ADDR_SIZE]; // Copie de l'adresse distante ("ip:port" UDP) de chaque socket
+send_window_t send_window[MAX_SOCKETS]; // Fenêtre d'émission (PDU en vol) de chaque socket
+recv_window_t recv_window[MAX_SOCKETS]; // Tampon de réordonnancement (PDU hors séquence) de chaque socket
+rtt_estimator_t rtt_estimator[MAX_SOCKETS]; // Estimation du RTT et RTO de chaque socket
+congestion_ctl_t congestion[MAX_SOCKETS]; // Contrôle de congestion de chaque socket
+mic_tcp_timer rto_timer[MAX_SOCKETS]; // Timer de retransmission des PDU en vol de chaque socket
+mic_tcp_timer handshake_timer[MAX_SOCKETS]; // Timer de retransmission du SYN / SYN-ACK de chaque socket
+handshake_t handshake[MAX_SOCKETS]; // Suivi de l'établissement de connexion de chaque socket
+int listener_of[MAX_SOCKETS]; // Socket en écoute d'une connexion pas encore acceptée (-1 sinon)
+int accept_head[MAX_SOCKETS]; // File des connexions établies en attente de mic_tcp_accept(), par socket en écoute
+int accept_tail[MAX_SOCKETS];
+int accept_next[MAX_SOCKETS]; // Connexion suivante dans la file (-1 en fin de file)
+pthread_t protocol_th; // Thread protocole : timers de tous les sockets
+unsigned short next_ephemeral_port = EPHEMERAL_PORT_MIN; // Prochain port local attribué par mic_tcp_connect()
+int protocol_started = 0; // 1 une fois le thread protocole démarré
+int nonblocking[MAX_SOCKETS]; // 1 si le socket est en mode non bloquant (option MIC_TCP_NONBLOCK)
+int stream_mode[MAX_SOCKETS]; // 1 si mic_tcp_recv() lit un flux d'octets (option MIC_TCP_STREAM)
+int event_fd[MAX_SOCKETS]; // eventfd signalé quand l'état du socket change (0 tant qu'il n'est pas créé)
+int event_watched[MAX_SOCKETS]; // 1 si mic_tcp_poll() ou mic_tcp_get_eventfd() attend ce socket
+mic_tcp_completion completions[MAX_SOCKETS][MIC_TCP_CQ_SIZE]; // File des complétions non lues de chaque socket
+unsigned int cq_head[MAX_SOCKETS], cq_tail[MAX_SOCKETS];
+int async_pending[MAX_SOCKETS]; // Opérations asynchrones soumises et pas encore terminées
+async_recv_t posted_recv[MAX_SOCKETS][MIC_TCP_CQ_SIZE]; // Tampons de mic_tcp_recv_async() en attente de données
+unsigned int posted_head[MAX_SOCKETS], posted_tail[MAX_SOCKETS];
+long coalesce_delay[MAX_SOCKETS]; // Attente max en µs d'un PDU incomplet (option MIC_TCP_COALESCE, 0 : désactivé)
+int corked[MAX_SOCKETS]; // 1 si les PDU incomplets attendent mic_tcp_flush() (option MIC_TCP_CORK)
+int flush_requested[MAX_SOCKETS]; // 1 si le PDU incomplet en attente doit partir sans attendre
+mic_tcp_timer coalesce_timer[MAX_SOCKETS]; // Timer bornant l'attente du PDU incomplet de chaque socket
+int ack_every[MAX_SOCKETS]; // Nombre de PDU reçus dans l'ordre par ACK (option MIC_TCP_ACK_EVERY)
+long ack_delay[MAX_SOCKETS]; // Attente max en µs d'un ACK retardé (option MIC_TCP_ACK_DELAY)
+int pending_acks[MAX_SOCKETS]; // PDU reçus depuis le dernier ACK envoyé
+mic_tcp_timer ack_timer[MAX_SOCKETS]; // Timer de l'ACK retardé de chaque socket
+int forward_pending[MAX_SOCKETS]; // 1 si des PDU abandonnés doivent encore être annoncés au puits
+unsigned int forward_base[MAX_SOCKETS]; // Base annoncée par le dernier PDU FORWARD
+unsigned long forward_time[MAX_SOCKETS]; // Date d'envoi du dernier FORWARD en µs (0 : confirmé par un ACK)
+long linger_time[MAX_SOCKETS]; // Attente max en µs des PDU en vol à la fermeture (option MIC_TCP_LINGER)
+long message_lifetime[MAX_SOCKETS]; // Durée de vie en µs des messages envoyés (option MIC_TCP_DEADLINE, 0 : sans échéance)
+socket_counters_t counters[MAX_SOCKETS]; // Compteurs de trafic de chaque socket
+mic_tcp_stats_segment* stats_segment = NULL; // Statistiques publiées en mémoire partagée (NULL : pas d'export)
+mic_tcp_timer export_timer; // Timer de publication des statistiques
+pthread_mutex_t stats_lock = PTHREAD_MUTEX_INITIALIZER; // Protège la création du segment
 
 /*
  * Fonction pour afficher le nom de la fonction passée en paramètre
  */
 void print_func_name(const char* func_name) {
-   printf("[MIC-TCP] Appel de la fonction: %s\n", func_name);
+   LOG_DEBUG("[MIC-TCP] Appel de la fonction: %s\n", func_name);
 }
 
 
@@ -23,85 +79,119 @@ void print_func_name(const char* func_name) {
 //!    |_PARTIE_FENETRE_GLISSANTE_| (structure définie dans mictcp.h)
 
 /*
- * Initialise la fenêtre glissante pour un socket
+ * Initialise la fenêtre glissante pour un socket, vide, de size paquets
+ * et en mode décroissance si decay > 0 (constante de temps en µs)
+ * Les PDU déjà comptés dans l'ancienne fenêtre n'y sont plus retrouvés
  */
-void init_a_sliding_window(int socket) {
+void init_a_sliding_window(int socket, unsigned int size, unsigned long decay) {
    print_func_name(__FUNCTION__);
    // A l'adresse du descripteur socket, on initialise la fenêtre glissante
    sliding_window_t *window = &loss_window[socket];
-   
-   // Initialiser tous les éléments à 0
-   for (int i = 0; i < WINDOW_SIZE; i++) {
-      window->sent_packets[i] = 0;
-      window->ack_received[i] = 0;
-   }
-   
-   window->window_index = 0;
-   window->packets_in_window = 0;
-   
-   printf("[MIC-TCP] Fenêtre glissante initialisée pour socket %d\n", socket);
+
+   memset(window->lost, 0, sizeof(window->lost));
+   window->size = size;
+   window->lost_count = 0;
+   window->start = window->total; // Les positions antérieures ne sont plus dans la fenêtre
+   window->decay = decay;
+   window->lost_weight = 0;
+   window->total_weight = 0;
+   window->last_update = get_now_time_usec();
+
+   LOG_DEBUG("[MIC-TCP] Fenêtre glissante initialisée pour socket %d\n", socket);
+}
+
+/*
+ * Mode décroissance : vieillit les poids de la fenêtre jusqu'à la date now
+ */
+void decay_loss_window(sliding_window_t *window, unsigned long now) {
+   if (now <= window->last_update) return;
+   double factor = exp(-(double) (now - window->last_update) / window->decay);
+   window->lost_weight *= factor;
+   window->total_weight *= factor;
+   window->last_update = now;
 }
 
 /*
- * Ajoute un paquet envoyé dans la fenêtre glissante
+ * Ajoute un paquet dont le sort est connu dans la fenêtre glissante
+ * Le paquet n'est compté qu'une fois son sort connu (ACK reçu ou premier timeout),
+ * pour que les PDU encore en vol ne soient pas comptés comme perdus.
+ * Le plus ancien paquet sort de la fenêtre : les compteurs sont mis à jour en O(1)
  */
-void add_sent_packet(int socket) {
+void add_sent_packet(int socket, send_slot_t *slot, int lost) {
    // A l'adresse de socket, on ajoute un paquet envoyé dans la fenêtre glissante
    sliding_window_t *window = &loss_window[socket];
-   
-   // Ajouter le paquet à la position courante
-   window->sent_packets[window->window_index] = 1;
-   window->ack_received[window->window_index] = 0; // Pas encore d'ACK
-   
-   // Avancer l'index (circulaire car modulo WINDOW_SIZE)
-   window->window_index = (window->window_index + 1) % WINDOW_SIZE;
-   
-   // Incrémenter le nombre de paquets si la fenêtre n'est pas pleine
-   if (window->packets_in_window < WINDOW_SIZE) window->packets_in_window++;
-   
-   printf("[MIC-TCP] Socket %d: Paquet ajouté à la fenêtre (total: %d)\n", socket, window->packets_in_window);
+   slot->in_loss_window = 1;
+   slot->loss_pos = window->total;
+   slot->loss_time = get_now_time_usec();
+
+   if (window->decay > 0) {
+      decay_loss_window(window, slot->loss_time);
+      window->total_weight += 1;
+      if (lost) window->lost_weight += 1;
+   } else {
+      unsigned int index = window->total % window->size;
+      uint64_t bit = 1ULL << (index % 64);
+      //? La fenêtre est pleine : le paquet remplace le plus ancien, qui en sort
+      if (window->total - window->start >= window->size && (window->lost[index / 64] & bit)) window->lost_count--;
+      if (lost) {
+         window->lost[index / 64] |= bit;
+         window->lost_count++;
+      } else {
+         window->lost[index / 64] &= ~bit;
+      }
+   }
+   window->total++;
+   LOG_DEBUG("[MIC-TCP] Socket %d: Paquet %u ajouté à la fenêtre (%s)\n", socket, slot->seq_num, lost ? "perdu" : "acquitté");
 }
 
 /*
- * Marque un ACK comme reçu dans la fenêtre glissante
+ * Un paquet compté comme perdu a finalement été acquitté : il n'est plus compté
+ * comme perte, s'il est encore dans la fenêtre
  */
-void mark_ack_received(int socket) {
+void mark_ack_received(int socket, send_slot_t *slot) {
    // A l'adresse de socket, on marque un ACK comme reçu dans la fenêtre glissante
    sliding_window_t *window = &loss_window[socket];
-   
-   // Marquer l'ACK pour le dernier paquet envoyé
-   int last_sent_index = (window->window_index - 1 + WINDOW_SIZE) % WINDOW_SIZE; // Modulo pour gérer l'index circulaire
-   window->ack_received[last_sent_index] = 1;
-   
-   printf("[MIC-TCP] Socket %d: ACK marqué comme reçu\n", socket);
+
+   if (window->decay > 0) {
+      unsigned long now = get_now_time_usec();
+      decay_loss_window(window, now);
+      //? La perte a décru depuis son entrée : on retire son poids actuel
+      if (slot->loss_pos >= window->start) {
+         window->lost_weight -= exp(-(double) (now - slot->loss_time) / window->decay);
+         if (window->lost_weight < 0) window->lost_weight = 0;
+      }
+      return;
+   }
+   //? Position hors de la fenêtre (trop ancienne ou d'avant une réinitialisation) : rien à corriger
+   if (slot->loss_pos < window->start || window->total - slot->loss_pos > window->size) return;
+   unsigned int index = slot->loss_pos % window->size;
+   uint64_t bit = 1ULL << (index % 64);
+   if (window->lost[index / 64] & bit) {
+      window->lost[index / 64] &= ~bit;
+      window->lost_count--;
+      LOG_DEBUG("[MIC-TCP] Socket %d: ACK marqué comme reçu (seq %u)\n", socket, slot->seq_num);
+   }
 }
 
 /*
- * Calcule le taux de perte dans la fenêtre glissante actuelle
+ * Calcule le taux de perte dans la fenêtre glissante actuelle, en O(1)
  * Retourne le pourcentage de perte (0-100)
  */
 int calculate_current_loss_rate(int socket) {
    sliding_window_t *window = &loss_window[socket];
-   
-   if (window->packets_in_window == 0) return 0; // Pas de paquets envoyés
-   
-   int sent_count = 0, ack_count = 0;
-   
-   // Compter les paquets envoyés et les ACK reçus
-   for (int i = 0; i < window->packets_in_window; i++) {
-      if (window->sent_packets[i] == 1) {
-         sent_count++;
-         if (window->ack_received[i] == 1) {
-            ack_count++;
-         }
-      }
+
+   if (window->decay > 0) {
+      decay_loss_window(window, get_now_time_usec());
+      if (window->total_weight <= 0) return 0; // Pas de paquets envoyés
+      return (int) (window->lost_weight * 100 / window->total_weight);
    }
-   
-   if (sent_count == 0) return 0; // Pas de paquets envoyés, pas de perte
+   unsigned long packets = window->total - window->start;
+   if (packets > window->size) packets = window->size;
+   if (packets == 0) return 0; // Pas de paquets envoyés, pas de perte
    // Calculer le taux de perte
-   int loss_rate_percent = ((sent_count - ack_count) * 100) / sent_count;
-   
-   printf("[MIC-TCP] Socket %d: Taux de perte calculé: %d%% (%d perdus sur %d)\n", socket, loss_rate_percent, sent_count - ack_count, sent_count);
+   int loss_rate_percent = (window->lost_count * 100) / packets;
+
+   LOG_DEBUG("[MIC-TCP] Socket %d: Taux de perte calculé: %d%% (%u perdus sur %lu)\n", socket, loss_rate_percent, window->lost_count, packets);
    return loss_rate_percent;
 }
 
@@ -110,9 +200,19 @@ int calculate_current_loss_rate(int socket) {
  * Retourne 0 si on peut "mentir" sur le numéro de séquence, -1 sinon
  */
 int can_accept_loss(int socket) { 
-   int current_loss_rate = calculate_current_loss_rate(socket);
-   
-   if (current_loss_rate <= acceptable_loss_rate) return 0; // On peut accepter la perte
+   sliding_window_t *window = &loss_window[socket];
+   //? Fiabilité totale : un PDU perdu de nouveau peut être déjà sorti de la fenêtre des pertes
+   if (acceptable_loss_rate[socket] == 0) return -1;
+   //? Comparaison exacte (sans arrondir le taux au pourcent) : avec une grande fenêtre,
+   //? une seule perte ne doit pas passer pour 0% sur une connexion totalement fiable
+   if (window->decay > 0) {
+      decay_loss_window(window, get_now_time_usec());
+      if (window->lost_weight * 100 <= acceptable_loss_rate[socket] * window->total_weight) return 0;
+      return -1;
+   }
+   unsigned long packets = window->total - window->start;
+   if (packets > window->size) packets = window->size;
+   if ((unsigned long) window->lost_count * 100 <= (unsigned long) acceptable_loss_rate[socket] * packets) return 0; // On peut accepter la perte
    return -1; // Doit continuer à attendre l'ACK
 }
 
@@ -121,426 +221,2175 @@ int can_accept_loss(int socket) {
  */
 void debug_window(int socket) {
    sliding_window_t *window = &loss_window[socket];
-   printf("[MIC-TCP] Fenêtre glissante pour le socket %d:\n", socket);
-   printf("  Index courant: %d\n", window->window_index);
-   printf("  Paquets dans la fenêtre: %d\n", window->packets_in_window);
-   printf("  Paquets envoyés: ");
-   for (int i = 0; i < WINDOW_SIZE; i++) {
-      printf("%d ", window->sent_packets[i]);
-   }
-   printf("\n  ACK reçus: ");
-   for (int i = 0; i < WINDOW_SIZE; i++) {
-      printf("%d ", window->ack_received[i]);
-   }
-   printf("\n");
+   LOG_DEBUG("[MIC-TCP] Fenêtre glissante pour le socket %d:\n", socket);
+   LOG_DEBUG("  Taille: %u paquets, décroissance: %lu µs\n", window->size, window->decay);
+   LOG_DEBUG("  Paquets comptés: %lu, pertes dans la fenêtre: %u\n", window->total - window->start, window->lost_count);
+   LOG_DEBUG("  Taux de perte: %d%%\n", calculate_current_loss_rate(socket));
 }
 
-//!     _______________________
-//!    |_PARTIE_VERIFICATIONS_|
+//!     ________________________
+//!    |_PARTIE_ESTIMATION_RTT_| (RFC 6298, structure définie dans mictcp.h)
 
 /*
- * Fonction de vérification de la validité d'un socket
- * Retourne 0 si le socket est valide, -1 sinon
+ * Borne le RTO entre les limites configurées du socket
  */
-int verif_socket(int socket) {
-   if (socket < 0 || socket > last_used_socket) {
-      printf("[MIC-TCP] Erreur: Socket invalide\n");
-      return -1;
+unsigned long clamp_rto(rtt_estimator_t *est, unsigned long rto) {
+   if (rto < est->min_rto) return est->min_rto;
+   if (rto > est->max_rto) return est->max_rto;
+   return rto;
+}
+
+/*
+ * Initialise l'estimateur de RTT d'un socket avec les bornes par défaut
+ */
+void init_rtt_estimator(int socket) {
+   rtt_estimator_t *est = &rtt_estimator[socket];
+   memset(est, 0, sizeof(rtt_estimator_t));
+   est->min_rto = DEFAULT_MIN_RTO;
+   est->max_rto = DEFAULT_MAX_RTO;
+   est->rto = clamp_rto(est, INITIAL_RTO);
+}
+
+/*
+ * Intègre une mesure de RTT (en µs) et recalcule le RTO
+ * Règle de Karn : l'appelant ne fournit que des mesures de PDU jamais retransmis
+ */
+void rtt_sample(int socket, unsigned long rtt) {
+   rtt_estimator_t *est = &rtt_estimator[socket];
+   if (est->samples == 0) {
+      // Première mesure : SRTT = R, RTTVAR = R/2
+      est->srtt = rtt;
+      est->rttvar = rtt / 2;
+      est->min_rtt = rtt;
+   } else {
+      // RTTVAR = 3/4 RTTVAR + 1/4 |SRTT - R|, puis SRTT = 7/8 SRTT + 1/8 R
+      unsigned long delta = est->srtt > rtt ? est->srtt - rtt : rtt - est->srtt;
+      est->rttvar = (3 * est->rttvar + delta) / 4;
+      est->srtt = (7 * est->srtt + rtt) / 8;
+      if (rtt < est->min_rtt) est->min_rtt = rtt;
    }
-   return 0;
+   est->last_rtt = rtt;
+   est->samples++;
+   // RTO = SRTT + 4 RTTVAR, une nouvelle mesure annule le backoff
+   est->rto = clamp_rto(est, est->srtt + 4 * est->rttvar);
 }
 
 /*
- * Fonction de vérification de la validité d'une adresse
- * Retourne 0 si l'adresse est valide, -1 sinon
+ * Double le RTO après l'expiration du timer d'un PDU envoyé à la date sent_time.
+ * Les PDU envoyés avant le dernier doublement appartiennent au même épisode de
+ * perte : leurs expirations ne doublent pas à nouveau le RTO
+ * Retourne 1 si l'expiration ouvre un nouvel épisode de perte, 0 sinon
  */
-int verif_address(mic_tcp_sock_addr addr) {
-   // Vérifie que le port est valide (> 1024)
-   if (addr.port <= 1024) return -1;
+int rto_backoff(int socket, unsigned long sent_time) {
+   rtt_estimator_t *est = &rtt_estimator[socket];
+   est->expirations++;
+   if (sent_time < est->backoff_time) return 0;
+   est->rto = clamp_rto(est, 2 * est->rto);
+   est->backoff_time = get_now_time_usec();
+   est->backoffs++;
+   LOG_DEBUG("[MIC-TCP] Socket %d: RTO doublé à %lu µs\n", socket, est->rto);
+   return 1;
+}
 
-   if(strstr(addr.ip_addr.addr, "localhost")) return 0; // Si l'adresse est "localhost", on considère que c'est valide
+//!     _____________________________
+//!    |_PARTIE_CONTROLE_CONGESTION_| (algorithmes dans mictcp_cc.c)
 
-   // Vérifie que la taille de l'adresse IP est non nulle
-   if (addr.ip_addr.addr_size == 0 || addr.ip_addr.addr == NULL) return -1;
+/*
+ * Initialise le contrôle de congestion d'un socket avec l'algorithme demandé
+ * Retourne 0 si succès, -1 si l'algorithme est inconnu
+ */
+int init_congestion(int socket, mic_tcp_cc_algo algo) {
+   const cc_ops_t *ops = cc_get_ops(algo);
+   if (ops == NULL) return -1;
+   congestion_ctl_t *cc = &congestion[socket];
+   cc->algo = algo;
+   cc->ops = ops;
+   cc->events = 0;
+   ops->init(&cc->state);
+   // Les pertes des PDU déjà émis n'ouvrent pas d'épisode pour le nouvel algorithme
+   cc->state.recovery_point = next_sequence[socket];
+   LOG_INFO("[MIC-TCP] Socket %d: contrôle de congestion %s\n", socket, ops->name);
+   return 0;
+}
 
-   // On copie l'adresse IP
-   char ip_copy[addr.ip_addr.addr_size + 1];
-   strncpy(ip_copy, addr.ip_addr.addr, addr.ip_addr.addr_size);
-   ip_copy[addr.ip_addr.addr_size] = '\0'; // Ajoute le caractère de fin de chaîne
+/*
+ * Nombre de PDU que la fenêtre de congestion autorise en vol
+ */
+unsigned int cc_window(int socket) {
+   double cwnd = congestion[socket].state.cwnd;
+   if (cwnd < 1) return 1;
+   if (cwnd > SEND_WINDOW_SIZE) return SEND_WINDOW_SIZE;
+   return (unsigned int) cwnd;
+}
 
-   // Compte le nombre de segments dans l'adresse IP
-   int segments = 0;
-   char* token = strtok(ip_copy, "."); // On découpe l'adresse IP en segments
+/*
+ * Transmet à l'algorithme les PDU nouvellement acquittés par un ACK
+ * et termine la récupération quand l'ACK cumulatif dépasse le point de récupération
+ */
+void cc_ack(int socket, unsigned int acked, unsigned int cumulative) {
+   congestion_ctl_t *cc = &congestion[socket];
+   if (cc->state.in_recovery && SEQ_LEQ(cc->state.recovery_point, cumulative)) {
+      cc->state.in_recovery = 0;
+   }
+   if (acked > 0) cc->ops->on_ack(&cc->state, acked, rtt_estimator[socket].srtt, get_now_time_usec());
+}
 
-   while (token != NULL) {
-      // Convertit le segment en entier
-      char* endptr;
-      long value = strtol(token, &endptr, 10);
+/*
+ * Perte du PDU seq détectée par les SACK : une seule réduction par épisode,
+ * les PDU émis avant le début de la récupération appartiennent au même épisode
+ */
+void cc_loss(int socket, unsigned int seq) {
+   congestion_ctl_t *cc = &congestion[socket];
+   if (SEQ_LT(seq, cc->state.recovery_point)) return;
+   cc->state.in_recovery = 1;
+   cc->state.recovery_point = next_sequence[socket];
+   cc->ops->on_loss(&cc->state, get_now_time_usec());
+   cc->events++;
+   LOG_DEBUG("[MIC-TCP] Socket %d: perte, fenêtre de congestion réduite à %.1f PDU\n", socket, cc->state.cwnd);
+   TRACE(TRACE_CWND_REDUCED, socket, seq, 0, cc->state.cwnd * 100);
+}
 
-      // Vérifie que la conversion est valide et dans l'intervalle 0-255
-      if (*endptr != '\0' || value < 0 || value > 255) return -1;
+/*
+ * Expiration du timer de retransmission ouvrant un nouvel épisode de perte
+ */
+void cc_timeout(int socket) {
+   congestion_ctl_t *cc = &congestion[socket];
+   cc->ops->on_timeout(&cc->state, get_now_time_usec());
+   // Retour en slow start : la fenêtre peut croître, mais les pertes déjà en vol
+   // n'ouvrent pas de nouvel épisode
+   cc->state.in_recovery = 0;
+   cc->state.recovery_point = next_sequence[socket];
+   cc->events++;
+   LOG_DEBUG("[MIC-TCP] Socket %d: timeout, fenêtre de congestion réduite à %.1f PDU\n", socket, cc->state.cwnd);
+   TRACE(TRACE_CWND_REDUCED, socket, send_window[socket].base, 0, cc->state.cwnd * 100);
+}
 
-      segments++;
-      token = strtok(NULL, ".");
+//!     ____________________
+//!    |_PARTIE_EVENEMENTS_| (appelée avec le mutex du socket verrouillé)
+
+/*
+ * Signale un changement d'état du socket (donnée délivrée, place dans la fenêtre,
+ * connexion prête, fermeture), seulement si quelqu'un l'attend
+ */
+void notify_socket(int socket) {
+   uint64_t one = 1;
+   if (event_watched[socket] && write(event_fd[socket], &one, sizeof(one)) == -1) perror("[MIC-TCP] eventfd");
+}
+
+/*
+ * Crée au besoin l'eventfd du socket et le marque comme attendu
+ * Il est conservé quand le descripteur est réutilisé, comme sa file de réception
+ * Retourne l'eventfd ou -1 en cas d'erreur
+ */
+int watch_socket(int socket) {
+   if (event_fd[socket] <= 0) {
+      event_fd[socket] = eventfd(0, EFD_NONBLOCK);
+      if (event_fd[socket] == -1) {
+         event_fd[socket] = 0;
+         return -1;
+      }
    }
+   event_watched[socket] = 1;
+   return event_fd[socket];
+}
 
-   // Vérifie qu'on a exactement 4 segments (X.X.X.X) pour IPv4
-   if (segments != 4) return -1;
+//!     _____________________
+//!    |_PARTIE_ASYNCHRONE_| (appelée avec le mutex du socket verrouillé)
+
+/*
+ * Une nouvelle opération asynchrone peut être soumise : sa complétion
+ * trouvera toujours une place dans la file
+ */
+int async_room(int socket) {
+   return async_pending[socket] + (int) (cq_tail[socket] - cq_head[socket]) < MIC_TCP_CQ_SIZE;
+}
+
+/*
+ * Termine une opération asynchrone et réveille le thread qui attend ses complétions
+ */
+void post_completion(int socket, mic_tcp_completion_type type, int result, void* user_data) {
+   mic_tcp_completion *completion = &completions[socket][cq_tail[socket]++ % MIC_TCP_CQ_SIZE];
+   completion->socket = socket;
+   completion->type = type;
+   completion->result = result;
+   completion->user_data = user_data;
+   async_pending[socket]--;
+   pthread_cond_broadcast(&socket_list[socket].cond);
+   notify_socket(socket);
+}
 
+/*
+ * Délivre une donnée dans l'ordre : dans les plus anciens tampons de mic_tcp_recv_async()
+ * s'il y en a, sinon dans la file de réception du socket. Ce qui dépasse des tampons
+ * rejoint la file (un tampon n'est en attente que si la file est vide, l'ordre est
+ * conservé et la file a de la place)
+ * Retourne 0, ou -1 si la file de réception est pleine
+ */
+int deliver_payload(int fd, mic_tcp_payload payload) {
+   int filled = 0, total = payload.size;
+   //? Une donnée vide termine aussi un tampon
+   while (posted_head[fd] != posted_tail[fd] && (payload.size > 0 || !filled)) {
+      async_recv_t *posted = &posted_recv[fd][posted_head[fd]++ % MIC_TCP_CQ_SIZE];
+      int size = min_size(payload.size, posted->size);
+      memcpy(posted->data, payload.data, size);
+      payload.data += size;
+      payload.size -= size;
+      filled = 1;
+      post_completion(fd, MIC_TCP_RECV_DONE, size, posted->user_data);
+   }
+   if (!(filled && payload.size == 0) && app_buffer_put(fd, payload) == -1) return -1;
+   counters[fd].bytes_received += total;
    return 0;
 }
 
-//!     _______________________________
-//!    |_PARTIE_FONCTIONS_PRINCIPALES_|
+//!     __________________
+//!    |_PARTIE_ECHEANCE_| (fiabilité partielle par échéance, option MIC_TCP_DEADLINE)
+// Un message à échéance est toujours envoyé une fois (le RTT reste ainsi mesuré),
+// puis retransmis tant qu'il peut encore arriver à temps,
+// puis abandonné quel que soit le taux de perte : le puits le saute grâce à la
+// base de la fenêtre transmise dans les PDU suivants
 
 /*
- * Permet de créer un socket entre l’application et MIC-TCP
- * Retourne le descripteur du socket ou bien -1 en cas d'erreur
+ * Echéance d'un message envoyé maintenant sur le socket (0 : sans échéance)
  */
-int mic_tcp_socket(start_mode sm){
-   int result = -1;
-   print_func_name(__FUNCTION__);
-   result = initialize_components(sm); /* Appel obligatoire */
-   set_loss_rate(real_loss_rate); /* On initialise le taux de perte, c'est la fonction IP_send() qui gère */
-   
-   // Verifie si la liste de sockets est pleine
-   if (last_used_socket > MAX_SOCKETS) return -1;
-   
-   socket_list[last_used_socket].fd = last_used_socket;
-   socket_list[last_used_socket].state = CLOSED;
-   
-   // Initialiser la fenêtre glissante pour ce socket
-   init_a_sliding_window(last_used_socket);
-   
-   int socket = last_used_socket; // On récupère le descripteur du socket
-   last_used_socket++;
+unsigned long message_deadline(int socket) {
+   if (message_lifetime[socket] <= 0) return 0;
+   return get_now_time_usec() + message_lifetime[socket];
+}
 
-   // Retourne le descripteur du socket ou -1 en cas d'erreur
-   return result == -1 ? result : socket;
+/*
+ * Echéance d'un PDU qui regroupe des messages d'échéances a et b : la plus tardive,
+ * pour ne pas abandonner les derniers octets avec les premiers (0 l'emporte : sans échéance)
+ */
+unsigned long merge_deadlines(unsigned long a, unsigned long b) {
+   if (a == 0 || b == 0) return 0;
+   return a > b ? a : b;
 }
 
 /*
- * Permet d’attribuer une adresse à un socket.
- * Retourne 0 si succès, et -1 en cas d’échec
+ * Retourne 1 si le PDU, retransmis maintenant, arriverait après son échéance
+ * (temps de trajet estimé à SRTT/2), 0 s'il peut encore arriver à temps ou n'a pas d'échéance
  */
-int mic_tcp_bind(int socket, mic_tcp_sock_addr addr) {
-   print_func_name(__FUNCTION__);
-   
-   //Vérifie si le socket est valide et si l'adresse est valide
-   if (verif_socket(socket) == 0) {
-      // Attribue addr au socket
-      socket_list[socket].local_addr = addr; /* On attribue l'adresse au socket */
-      printf("[MIC-TCP] Socket %d lié à l'adresse %s:%d\n", socket, addr.ip_addr.addr, addr.port);
-      return 0;
-   }
-   return -1;
+int deadline_missed(int socket, send_slot_t *slot, unsigned long now) {
+   if (slot->deadline == 0) return 0;
+   return now + rtt_estimator[socket].srtt / 2 >= slot->deadline;
 }
 
+//!     _______________________
+//!    |_PARTIE_REGROUPEMENT_| (appelée avec le mutex du socket verrouillé)
+// Algorithme de Nagle : tant que des PDU sont en vol, le dernier PDU en attente
+// reste incomplet et les envois suivants le complètent. Il part quand il est plein,
+// quand tout est acquitté, après coalesce_delay µs ou sur mic_tcp_flush()
+
 /*
- * Met le socket en état d'acceptation de connexions
- * Retourne 0 si succès, -1 si erreur
+ * Retourne 1 si le regroupement est actif sur le socket (MIC_TCP_COALESCE ou MIC_TCP_CORK)
  */
-int mic_tcp_accept(int socket, mic_tcp_sock_addr* addr) {
-   print_func_name(__FUNCTION__);
-   
-   // Vérifie si le socket est valide
-   if (verif_socket(socket) == -1) return -1;
-   
-   //? Met le socket en état d'acceptation de connexions
-   socket_list[socket].state = IDLE; // On change l'état du socket
-   printf("[MIC-TCP] Socket %d en attente de connexion...\n", socket);
+int coalescing(int socket) {
+   return corked[socket] || coalesce_delay[socket] > 0;
+}
 
-   // On utilise un mutex et une condition pour attendre que la connexion soit établie
-   pthread_mutex_lock(&socket_list[socket].mutex);
-   
-   //? Attente passive jusqu'à ce qu'une connexion soit établie
-   while(socket_list[socket].state != ESTABLISHED) {
-      // Le thread se bloque jusqu'à ce qu'il soit réveillé
-      pthread_cond_wait(&socket_list[socket].cond, &socket_list[socket].mutex);
-   }
-   
-   pthread_mutex_unlock(&socket_list[socket].mutex);
-   
-   return 0; // Retourne 0 si la connexion est établie
+/*
+ * Retourne le dernier PDU de la fenêtre d'émission s'il n'est pas encore envoyé
+ * et peut recevoir d'autres octets, NULL sinon
+ */
+send_slot_t* coalescing_tail(int socket) {
+   if (!coalescing(socket) || send_window[socket].next_to_send == (unsigned int) next_sequence[socket]) return NULL;
+   send_slot_t *slot = &send_window[socket].slots[(next_sequence[socket] - 1) % SEND_WINDOW_SIZE];
+   if (slot->async || slot->size >= MAX_PAYLOAD_SIZE) return NULL;
+   return slot;
 }
 
 /*
- * Permet de réclamer l’établissement d’une connexion
- * Retourne 0 si la connexion est établie, et -1 en cas d’échec
+ * Retourne 1 si le PDU doit attendre d'être complété avant son envoi
+ * (et arme alors le timer qui borne cette attente), 0 s'il peut partir
  */
-int mic_tcp_connect(int socket, mic_tcp_sock_addr addr) {
-   print_func_name(__FUNCTION__);
-   // Vérifie si le socket est valide et si l'adresse est valide
-   if (verif_socket(socket) == -1 || verif_address(addr) == -1) return -1;
+int hold_segment(int socket, send_slot_t *slot) {
+   if (flush_requested[socket] || coalescing_tail(socket) != slot) return 0;
+   //? Sans cork, rien en vol : aucun ACK ne viendra déclencher l'envoi, le PDU part tout de suite
+   if (!corked[socket] && send_window[socket].outstanding == 0) return 0;
+   if (!corked[socket] && !timer_is_armed(&coalesce_timer[socket])) {
+      timer_arm(&coalesce_timer[socket], get_now_time_usec() + coalesce_delay[socket]);
+   }
+   return 1;
+}
 
-   socket_list[socket].state = IDLE;
-   // Assigner l'adresse distante au socket
-   socket_list[socket].remote_addr = addr;
+//!     __________________________
+//!    |_PARTIE_FENETRE_EMISSION_| (Selective Repeat, structure définie dans mictcp.h)
+// Les fonctions de cette partie sont appelées avec le mutex du socket verrouillé
 
-   //? Tant que la connexion n'est pas établie (pas de ACK), on envoie un SYN
-   while (socket_list[socket].state != ESTABLISHED) {
-      //? Envoi d'un SYN pour établir la connexion
-      mic_tcp_pdu pdu_syn;
-      pdu_syn.header.source_port = socket_list[socket].local_addr.port; 
-      pdu_syn.header.dest_port = addr.port;
-      pdu_syn.header.syn = 1; 
-      pdu_syn.header.ack = 0; 
-      pdu_syn.header.fin = 0;
-      pdu_syn.payload.size = 0;
-      //?  Le client transmet le taux acceptable de perte dans un champ innexistant du PDU
-      pdu_syn.header.ack_num = acceptable_loss_rate;
-
-      printf("[MIC-TCP] Envoi du SYN pour établir la connexion sur le socket %d\n", socket);
-      
-      if (IP_send(pdu_syn, addr.ip_addr) == -1) return -1; 
-
-      mic_tcp_pdu pdu_syn_ack;
-      mic_tcp_ip_addr local_addr_ack, remote_addr_ack;
-      local_addr_ack.addr = malloc(sizeof(char) * 16); 
-      local_addr_ack.addr_size = 16; 
-      remote_addr_ack.addr = malloc(sizeof(char) * 16); 
-      remote_addr_ack.addr_size = 16;
-      pdu_syn_ack.payload.size = 0; 
-
-      //? On attend un SYN-ACK en réponse, 3 fois MAX_TIMEOUT car SYN, SYN_ACK, ACK
-      int recv_status = IP_recv(&pdu_syn_ack, &local_addr_ack, &remote_addr_ack, 3*MAX_TIMEOUT); // Attente du SYN-ACK
-
-      //? Si on reçoit un SYN-ACK, on envoie un ACK pour finaliser la connexion
-      if (recv_status != -1 && pdu_syn_ack.header.syn == 1 && pdu_syn_ack.header.ack == 1) {
-         printf("SYN-ACK reçu pour le socket %d\n", socket);
-         // On a reçu un SYN-ACK, on envoie un ACK pour finaliser la connexion
-         // On réutilise le PDU pdu_syn pour envoyer l'ACK (pour éviter de créer un nouveau PDU)
-         pdu_syn.header.ack = 1; 
-         pdu_syn.header.syn = 0; 
-         if (IP_send(pdu_syn, addr.ip_addr) == -1) return -1; // Envoi de l'ACK
-         pthread_mutex_lock(&socket_list[socket].mutex);
-         socket_list[socket].state = ESTABLISHED; // On change l'état du socket
-         pthread_cond_signal(&socket_list[socket].cond);  // Réveille le thread en attente
-         pthread_mutex_unlock(&socket_list[socket].mutex);
-      }
+/*
+ * Réinitialise la fenêtre d'émission d'un socket et rend au pool les copies des données
+ */
+void reset_send_window(int socket) {
+   send_window_t *window = &send_window[socket];
+   for (int i = 0; i < SEND_WINDOW_SIZE; i++) {
+      pool_put(window->slots[i].buf);
    }
-   printf("[MIC-TCP] Connexion établie avec succès sur le socket %d\n", socket);     
-   return 0;
+   memset(window, 0, sizeof(send_window_t));
+   window->base = window->next_to_send = next_sequence[socket];
 }
 
 /*
- * Permet de réclamer l’envoi d’une donnée applicative
- * Retourne la taille des données envoyées, et -1 en cas d'erreur
+ * Nombre de PDU occupant la fenêtre d'émission (en attente d'envoi ou en vol, non résolus)
  */
-int mic_tcp_send (int mic_sock, char* mesg, int mesg_size) {
-   print_func_name(__FUNCTION__);
+unsigned int in_flight(int socket) {
+   return next_sequence[socket] - send_window[socket].base;
+}
 
-   // Vérifie si le socket est valide
-   if (verif_socket(mic_sock) == -1) return -1;
-   
-   // Création du mic_tcp_pdu qui crée automatiquement le mic_tcp_header et le mic_tcp_payload
-   // Création du PDU Ack pour la réponse
-   mic_tcp_pdu pdu, pdu_ack;
-   int effective_ip_send = -1; // Variable pour stocker le résultat de l'envoi sur la couche IP
-   //! Adresses IP locales et distantes du PDU
-   mic_tcp_ip_addr local_addr_ack, remote_addr_ack; // Variables pour stocker les adresses IP locales et distantes du PDU ACK
-   local_addr_ack.addr = malloc(sizeof(char) * 16); // Allocation de mémoire pour l'adresse IP locale
-   local_addr_ack.addr_size = 16; // Taille de l'adresse IP locale
-   remote_addr_ack.addr = malloc(sizeof(char) * 16); // Allocation de mémoire pour l'adresse IP distante
-   remote_addr_ack.addr_size = 16; // Taille de l'adresse IP distante
-   
-   //! Remplissage du PDU HEADER
-   //mettre le numero de port local source associé a mon_socket
-   pdu.header.source_port = socket_list[mic_sock].local_addr.port;
-   //mettre le numero de port distant destination associé a mon_socket
-   pdu.header.dest_port = socket_list[mic_sock].remote_addr.port;
-   // Pour le moment on ne gère pas les numéros de séquence et d'acquittement
+/*
+ * Envoie (ou renvoie) le PDU contenu dans un emplacement de la fenêtre d'émission
+ * Retourne le résultat de IP_send_pooled()
+ */
+int transmit_slot(int socket, send_slot_t *slot) {
+   mic_tcp_pdu pdu;
+   pdu.header.source_port = socket_list[socket].local_addr.port;
+   pdu.header.dest_port = socket_list[socket].remote_addr.port;
+   pdu.header.seq_num = slot->seq_num;
+   //? La base de la fenêtre indique au puits ce qui est résolu (acquitté ou abandonné) :
+   //? le PDU annonce les abandons aussi bien qu'un FORWARD
+   pdu.header.ack_num = send_window[socket].base;
+   forward_pending[socket] = 0;
    pdu.header.syn = 0;
    pdu.header.ack = 0;
    pdu.header.fin = 0;
-   //? Remplissage du numéro de séquence
-   pdu.header.seq_num = next_sequence[mic_sock]; // Numéro de séquence du PDU
-
-   //! Remplissage du PDU PAYLOAD
-   pdu.payload.data = mesg; // On met le message dans le payload
-   pdu.payload.size = mesg_size; // On met la taille du message dans le payload
-   pdu_ack.payload.size = 0; // Pas de données dans le PDU ACK
-
-   int ack_received = 0; // Variable pour savoir si on a reçu un ACK valide
-   int premier_envoi = 1; // Variable pour savoir si c'est le premier envoi du PDU
-
-   //! On boucle jusqu'à ce qu'on reçoive un ACK valide
-   while (ack_received == 0) { 
-      //? Envoi du PDU sur la couche IP
-      printf("[MIC-TCP] Envoi du PDU avec numéro de séquence : %d\n", pdu.header.seq_num);
-      effective_ip_send = IP_send(pdu, socket_list[mic_sock].remote_addr.ip_addr); // On envoie le PDU sur la couche IP
-      // Erreur lors de l'envoi du PDU
-      if (effective_ip_send == -1) return -1;
-      //? Ajouter le paquet à la fenêtre glissante
-      if (premier_envoi) { // on l'ajoute qu'une seule fois
-         add_sent_packet(mic_sock); 
-         premier_envoi = 0; 
-      }
-      
-
-      //? Attente d'un ACK avec timeout dans le cas où le PDU est perdu
-      int recv_status = IP_recv(&pdu_ack, &local_addr_ack, &remote_addr_ack, MAX_TIMEOUT); // On attend le PDU ACK sur la couche IP
-
-      //? On vérifie si le PDU_ACK reçu à un numéro de séquence valide
-      // num séquence PDU_ACK = num séquence du prochain PDU à émettre + 1 (car on attend un ACK pour le PDU envoyé)
-      if (recv_status != -1 
-         && pdu_ack.header.ack == 1
-         && pdu_ack.header.seq_num == next_sequence[mic_sock]+1)
-      {
-         ack_received = 1; // On a reçu un ACK valide donc on sort de la boucle
-         mark_ack_received(mic_sock); // On marque l'ACK comme reçu dans la fenêtre glissante
-         printf("[MIC-TCP] ACK reçu pour le PDU avec numéro de séquence : %d\n", pdu_ack.header.seq_num-1);
-         next_sequence[mic_sock]++; // On incrémente le numéro de séquence du prochain PDU à émettre
-      };
-
-      //? Pas de ACK reçu ou ACK invalide
-      if (recv_status == -1 || !ack_received) {
-         //? Vérifier le taux de perte
-         if (can_accept_loss(mic_sock) == -1) { 
-            // Si le taux de perte est trop élevé on continue à attendre un ACK valide
-            printf("[MIC-TCP] Taux de perte inacceptable, attente d'un ACK valide\n");
-            continue; // On continue à attendre un ACK valide
-         } else {
-            // Taux de perte acceptable, on "ment" sur le numéro de séquence
-            printf("[MIC-TCP] Perte PDU acceptable\n"); 
-            ack_received = 1; // On considère qu'on a reçu un ACK pour le PDU suivant
-            effective_ip_send = mesg_size; // Simuler un envoi réussi
-            // On n'appelle pas mark_ack_received ici car on n'a pas reçu d'ACK valide
-            // Donc pour les stats de la fenêtre glissante, on ne marque pas l'ACK comme reçu
-         }
-      }
+   pdu.header.fwd = 0;
+   pdu.payload.data = slot->buf->data;
+   pdu.payload.size = slot->size;
 
-      debug_window(mic_sock);
-      printf("[MIC-TCP] Numéro de séquence actuel pour le socket %d\n", next_sequence[mic_sock]);
+   LOG_DEBUG("[MIC-TCP] Envoi du PDU avec numéro de séquence : %u (envoi n°%d)\n", slot->seq_num, slot->transmissions + 1);
+   if (slot->transmissions == 0) {
+      counters[socket].segments_sent++;
+      counters[socket].bytes_sent += slot->size;
+      TRACE(TRACE_PDU_SENT, socket, slot->seq_num, pdu.header.ack_num, slot->size);
+   } else {
+      counters[socket].retransmissions++;
+      TRACE(TRACE_PDU_RETRANSMITTED, socket, slot->seq_num, pdu.header.ack_num, slot->transmissions + 1);
    }
-   return effective_ip_send; // Retourne la taille des données envoyées (return -1 en cas d'erreur)    
+   slot->sent_time = get_now_time_usec();
+   slot->transmissions++;
+   //? La copie du PDU est dans un tampon du pool : un envoi groupé la référence sans la recopier
+   return IP_send_pooled(pdu, socket_list[socket].remote_addr.ip_addr);
 }
 
 /*
- * Permet à l’application réceptrice de réclamer la récupération d’une donnée
- * stockée dans les buffers de réception du socket
- * Retourne le nombre d’octets lu ou bien -1 en cas d’erreur
- * NB : cette fonction fait appel à la fonction app_buffer_get()
+ * (Re)programme le timer de retransmission du socket sur l'échéance du plus ancien PDU en vol
  */
-int mic_tcp_recv (int socket, char* mesg, int max_mesg_size) {
-   print_func_name(__FUNCTION__);
-   //verifie si le socket est valide
-   if (verif_socket(socket) == -1) return -1;
+void arm_rto_timer(int socket) {
+   send_window_t *window = &send_window[socket];
+   unsigned long earliest = 0;
+   for (unsigned int seq = window->base; seq != window->next_to_send; seq++) {
+      send_slot_t *slot = &window->slots[seq % SEND_WINDOW_SIZE];
+      if (slot->state == SLOT_IN_FLIGHT && (earliest == 0 || slot->sent_time < earliest)) earliest = slot->sent_time;
+   }
+   //? Un FORWARD non confirmé est renvoyé comme un PDU perdu
+   if (forward_time[socket] != 0 && (earliest == 0 || forward_time[socket] < earliest)) earliest = forward_time[socket];
+   if (earliest == 0) timer_cancel(&rto_timer[socket]);
+   else timer_arm(&rto_timer[socket], earliest + rtt_estimator[socket].rto);
+}
 
-   mic_tcp_payload payload;
-   payload.data = mesg; // On met le message dans le payload
-   payload.size = max_mesg_size; // On met la taille du message dans le payload
-   // On lit le message dans le buffer de réception
-   return app_buffer_get(payload); //retourne le nombre d'octets -1 si erreur
+/*
+ * Fait glisser la base de la fenêtre d'émission sur les PDU résolus
+ * et réveille les threads en attente de place dans la fenêtre
+ */
+void advance_send_window(int socket) {
+   send_window_t *window = &send_window[socket];
+   unsigned int old_base = window->base;
+   while (window->base != window->next_to_send) {
+      send_slot_t *slot = &window->slots[window->base % SEND_WINDOW_SIZE];
+      if (slot->state == SLOT_IN_FLIGHT) break;
+      if (slot->state == SLOT_ABANDONED) forward_pending[socket] = 1; // Le puits doit sauter ce PDU
+      slot->state = SLOT_FREE;
+      pool_put(slot->buf); // La copie n'est plus nécessaire
+      slot->buf = NULL;
+      window->base++;
+   }
+   if (window->base != old_base) {
+      pthread_cond_broadcast(&socket_list[socket].cond);
+      notify_socket(socket);
+   }
 }
 
 /*
- * Traitement d’un PDU MIC-TCP reçu (mise à jour des numéros de séquence
- * et d'acquittement, etc.) puis insère les données utiles du PDU dans
- * le buffer de réception du socket. Cette fonction utilise la fonction
- * app_buffer_put().
+ * Envoie un PDU FORWARD : tous les PDU avant la base de la fenêtre sont résolus.
+ * Le puits délivre ce qu'il retenait au-delà des PDU abandonnés et les saute
+ * sans attendre de nouvelles données ; son ACK confirme le FORWARD
  */
-void process_received_PDU(mic_tcp_pdu pdu, mic_tcp_ip_addr local_addr, mic_tcp_ip_addr remote_addr) {
-   print_func_name(__FUNCTION__);
+void send_forward(int socket) {
+   mic_tcp_pdu pdu;
+   pdu.header.source_port = socket_list[socket].local_addr.port;
+   pdu.header.dest_port = socket_list[socket].remote_addr.port;
+   pdu.header.seq_num = send_window[socket].base;
+   pdu.header.ack_num = send_window[socket].base;
+   pdu.header.syn = 0;
+   pdu.header.ack = 0;
+   pdu.header.fin = 0;
+   pdu.header.fwd = 1;
+   pdu.payload.data = NULL;
+   pdu.payload.size = 0;
 
-   //? Vérifie si le PDU était destiné à un de nos sockets
-   int fd = -1;
-   for (int i = 0; i < MAX_SOCKETS && i < last_used_socket; i++) {
-      // Si le port local du socket correspond au port de destination du PDU
-      if (socket_list[i].local_addr.port == pdu.header.dest_port) {
-         fd = i; // On a trouvé le socket correspondant
-         break;
-      }
+   LOG_DEBUG("[MIC-TCP] Socket %d: FORWARD, PDU résolus jusqu'à %u\n", socket, pdu.header.ack_num - 1);
+   forward_pending[socket] = 0;
+   forward_base[socket] = pdu.header.ack_num;
+   forward_time[socket] = get_now_time_usec();
+   counters[socket].forwards_sent++;
+   TRACE(TRACE_FORWARD_SENT, socket, pdu.header.ack_num, 0, counters[socket].forwards_sent);
+   // En cas d'erreur d'envoi, le FORWARD sera renvoyé à l'expiration du timer
+   IP_send(pdu, socket_list[socket].remote_addr.ip_addr);
+}
+
+/*
+ * Abandonne un PDU en vol dont l'échéance est dépassée :
+ * la base de la fenêtre transmise dans les PDU suivants indiquera au puits de ne plus l'attendre
+ */
+void abandon_slot(int socket, send_slot_t *slot, unsigned long now) {
+   LOG_DEBUG("[MIC-TCP] Echéance dépassée, abandon du PDU %u\n", slot->seq_num);
+   TRACE(TRACE_DEADLINE_EXPIRED, socket, slot->seq_num, send_window[socket].base,
+         now > slot->deadline ? now - slot->deadline : 0);
+   send_window[socket].outstanding--;
+   slot->state = SLOT_ABANDONED;
+   counters[socket].deadline_drops++;
+   if (slot->async) post_completion(socket, MIC_TCP_SEND_ABANDONED, slot->size, slot->user_data);
+}
+
+/*
+ * Envoie les PDU en attente tant que la fenêtre de congestion le permet
+ */
+void try_transmit(int socket) {
+   send_window_t *window = &send_window[socket];
+   IP_batch_begin(); //? Les PDU partent ensemble (et en GSO si actif) à la fin
+   while (window->next_to_send != (unsigned int) next_sequence[socket] && window->outstanding < cc_window(socket)) {
+      send_slot_t *slot = &window->slots[window->next_to_send % SEND_WINDOW_SIZE];
+      if (hold_segment(socket, slot)) break;
+      slot->state = SLOT_IN_FLIGHT;
+      window->outstanding++;
+      window->next_to_send++;
+      // En cas d'erreur d'envoi, le PDU sera retransmis à l'expiration du timer
+      transmit_slot(socket, slot);
    }
-   if (fd == -1) {
-      printf("[MIC-TCP] PDU non destiné à un de nos sockets\n");
-      return; //on ne fait rien si le PDU n'est pas pour nous
+   IP_batch_end();
+   //? Le PDU incomplet est parti : plus rien n'attend d'être regroupé
+   if (window->next_to_send == (unsigned int) next_sequence[socket]) {
+      flush_requested[socket] = 0;
+      timer_cancel(&coalesce_timer[socket]);
    }
+   //? Aucun PDU de données n'a porté la nouvelle base : les abandons partent dans un FORWARD
+   if (forward_pending[socket]) send_forward(socket);
+   arm_rto_timer(socket);
+}
 
-   //! CREATION DU PDU à renvoyer, ACK, FIN ou autre (ACK par défault)
-   mic_tcp_pdu pdu_ack;
-   // On inverse les ports source et destination pour répondre
-   pdu_ack.header.source_port = pdu.header.dest_port;
-   pdu_ack.header.dest_port = pdu.header.source_port;
-   pdu_ack.header.seq_num = next_sequence[fd]; // Numéro de séquence du PDU
-   pdu_ack.header.ack = 1; 
-   pdu_ack.header.syn = 0; 
-   pdu_ack.payload.size = 0; // Pas de données dans le PDU ACK
+/*
+ * Un PDU en vol est déclaré perdu (timeout ou trou signalé par les SACK) :
+ * il est retransmis, ou abandonné si le taux de perte (ou son échéance) le permet
+ * Retourne -1 en cas d'erreur d'envoi, 0 sinon
+ */
+int handle_lost_slot(int socket, send_slot_t *slot) {
+   //? Première perte : le paquet est compté comme non acquitté dans la fenêtre des pertes
+   if (!slot->in_loss_window) add_sent_packet(socket, slot, 1);
 
-   //! Phase d'établissement de connexion
-   //? Si on recoit un SYN
-   if (socket_list[fd].state != ESTABLISHED && pdu.header.syn == 1 && pdu.header.ack == 0) {
-      printf("[MIC-TCP] SYN reçu, envoi du SYN-ACK\n");
-      //? Mise à jour du taux de perte acceptable depuis le client
-      acceptable_loss_rate = pdu.header.ack_num;
-      printf("[MIC-TCP] Taux de perte accepté par le client : %d%%\n", acceptable_loss_rate);
-      
-      mic_tcp_pdu pdu_recv;
-      pdu_recv.payload.data = 0; // On met le message dans le payload
-      pdu_recv.payload.size = 0; // On met la taille du message dans le payload
-      mic_tcp_ip_addr local_addr_recv, remote_addr_recv;
-      local_addr_recv.addr = malloc(sizeof(char) * 16);
-      local_addr_recv.addr_size = 16; 
-      remote_addr_recv.addr = malloc(sizeof(char) * 16); 
-      remote_addr_recv.addr_size = 16;
-     
-      pdu_ack.header.syn = 1; // pour le SYN-ACK
-
-      int received = 0; 
-      while (!received) {
-         IP_send(pdu_ack, remote_addr); // Envoi du SYN-ACK
-         printf("[MIC-TCP] Envoi du SYN-ACK pour le socket %d\n", fd);
-         int result = IP_recv(&pdu_recv, &local_addr_recv, &remote_addr_recv, 3*MAX_TIMEOUT);
-         printf("debug result : %d\n", result);
-         // Si on recoit un ACK pour le SYN-ACK
-         if (result != -1 && pdu_recv.header.ack == 1 && pdu_recv.header.syn == 0) { 
-            printf("[MIC-TCP] ACK reçu pour le SYN-ACK\n");
-
-            pthread_mutex_lock(&socket_list[fd].mutex);
-            //Assigner l'adresse distante au socket
-            socket_list[fd].remote_addr.port = pdu.header.source_port;
-            socket_list[fd].remote_addr.ip_addr = remote_addr;
-            socket_list[fd].state = ESTABLISHED; // On change l'état du socket
-            pthread_cond_signal(&socket_list[fd].cond);  // Réveille le thread en attente
-            pthread_mutex_unlock(&socket_list[fd].mutex);
-            received = 1; // On a reçu l'ACK
-            printf("[MIC-TCP] Connexion établie pour le socket %d\n", fd);
-         } 
+   //? Message à échéance : seule l'échéance décide, pas le taux de perte
+   if (slot->deadline != 0) {
+      unsigned long now = get_now_time_usec();
+      if (deadline_missed(socket, slot, now)) {
+         abandon_slot(socket, slot, now);
+         return 0;
       }
+      LOG_DEBUG("[MIC-TCP] Echéance du PDU %u pas encore atteinte, retransmission\n", slot->seq_num);
+      return transmit_slot(socket, slot);
    }
 
-   //! Phase de transfert des données
-   if (socket_list[fd].state == ESTABLISHED) {
-      //? Verifier le num de sequence du PDU
-      if (pdu.header.seq_num == next_sequence[fd] && pdu.header.ack == 0 && pdu.header.syn == 0 && pdu.header.fin == 0) {
-         // On met le PDU dans le buffer de réception du socket
-         app_buffer_put(pdu.payload);
-         next_sequence[fd]++; // On incrémente le numéro de séquence du prochain PDU à émettre
-      }
-
-      //? Envoi de l'ACK pour le PDU reçu
-      IP_send(pdu_ack, remote_addr); // Envoi de l'ACK
+   //? Vérifier le taux de perte
+   if (can_accept_loss(socket) == 0) {
+      // Taux de perte acceptable, on abandonne ce PDU : la base de la fenêtre
+      // transmise dans les PDU suivants indiquera au puits de ne plus l'attendre
+      LOG_DEBUG("[MIC-TCP] Perte PDU acceptable (seq %u)\n", slot->seq_num);
+      TRACE(TRACE_LOSS_ACCEPTED, socket, slot->seq_num, 0, calculate_current_loss_rate(socket));
+      slot->state = SLOT_ABANDONED;
+      counters[socket].losses_accepted++;
+      send_window[socket].outstanding--;
+      if (slot->async) post_completion(socket, MIC_TCP_SEND_ABANDONED, slot->size, slot->user_data);
+      return 0;
    }
+   LOG_DEBUG("[MIC-TCP] Taux de perte inacceptable, retransmission du PDU %u\n", slot->seq_num);
+   TRACE(TRACE_LOSS_REFUSED, socket, slot->seq_num, 0, calculate_current_loss_rate(socket));
+   return transmit_slot(socket, slot);
 }
 
 /*
- * Permet de réclamer la destruction d’un socket.
- * Engendre la fermeture de la connexion suivant le modèle de TCP.
- * Retourne 0 si tout se passe bien et -1 en cas d'erreur
+ * Marque un PDU en vol comme acquitté (cumulativement ou sélectivement)
+ * Retourne 1 si le PDU vient d'être acquitté, 0 s'il était déjà résolu
  */
-int mic_tcp_close (int socket) {
-   print_func_name(__FUNCTION__);
-   // Vérifie si le socket est valide
-   if (verif_socket(socket) == -1) return -1;
-   socket_list[socket].state = CLOSED; // On change l'état du socket
+int ack_slot(int socket, send_slot_t *slot) {
+   if (slot->state != SLOT_IN_FLIGHT) return 0;
+   slot->state = SLOT_ACKED;
+   send_window[socket].outstanding--;
+   if (slot->async) post_completion(socket, MIC_TCP_SEND_ACKED, slot->size, slot->user_data);
+   LOG_DEBUG("[MIC-TCP] ACK reçu pour le PDU avec numéro de séquence : %u\n", slot->seq_num);
+   // Le paquet rejoint la fenêtre des pertes, ou n'y est plus compté comme perdu
+   if (!slot->in_loss_window) add_sent_packet(socket, slot, 0);
+   else mark_ack_received(socket, slot);
+   return 1;
+}
 
-   // Réorganisation de la liste de sockets pour éviter les trous
-   for (int i = socket; i < last_used_socket-1; i++) {
-      socket_list[i] = socket_list[i + 1];
-      socket_list[i].fd = i; // Met à jour le descripteur de fichier
-      next_sequence[i] = next_sequence[i + 1]; // Met à jour le numéro de séquence
-      loss_window[i] = loss_window[i + 1];
-   }
-   last_used_socket--;
-   return 0;
-}
\ No newline at end of file
+/*
+ * Traite un ACK reçu par la source : l'ACK porte dans seq_num le prochain
+ * numéro attendu par le puits, tous les PDU qui le précèdent sont acquittés.
+ * Les blocs SACK de la charge utile acquittent les PDU reçus hors séquence,
+ * un PDU en vol suivi d'au moins DUP_THRESH PDU acquittés est retransmis sans attendre le timer.
+ * Le RTT est mesuré sur le plus récent PDU acquitté par cet ACK, s'il n'a jamais été retransmis
+ * Retourne -1 en cas d'erreur d'envoi, 0 sinon
+ */
+int handle_ack(int socket, mic_tcp_pdu *pdu_ack) {
+   send_window_t *window = &send_window[socket];
+   unsigned int cumulative = pdu_ack->header.seq_num;
+   unsigned int next = window->next_to_send;
+   send_slot_t *newest_acked = NULL; // PDU acquitté le plus récent, pour la mesure du RTT
+   unsigned int newly_acked = 0; // Nombre de PDU acquittés par cet ACK, pour le contrôle de congestion
+
+   // On ignore les ACK qui acquittent des PDU jamais émis
+   if (SEQ_LT(next, cumulative)) return 0;
+
+   //? Acquittement cumulatif
+   for (unsigned int seq = window->base; SEQ_LT(seq, cumulative); seq++) {
+      send_slot_t *slot = &window->slots[seq % SEND_WINDOW_SIZE];
+      if (ack_slot(socket, slot)) {
+         newest_acked = slot;
+         newly_acked++;
+      }
+   }
+
+   //? Acquittements sélectifs
+   mic_tcp_sack_block *blocks = (mic_tcp_sack_block *) pdu_ack->payload.data;
+   int nb_blocks = min_size(pdu_ack->header.ack_num, pdu_ack->payload.size / sizeof(mic_tcp_sack_block));
+   for (int i = 0; i < nb_blocks; i++) {
+      if (SEQ_LT(blocks[i].end, blocks[i].start) || SEQ_LT(next, blocks[i].end)) continue; // Bloc invalide
+      //? Le parcours commence au plus tôt à la base : un bloc très en arrière ne coûte rien
+      unsigned int start = SEQ_LT(blocks[i].start, window->base) ? window->base : blocks[i].start;
+      for (unsigned int seq = start; SEQ_LT(seq, blocks[i].end); seq++) {
+         send_slot_t *slot = &window->slots[seq % SEND_WINDOW_SIZE];
+         if (!ack_slot(socket, slot)) continue;
+         newly_acked++;
+         if (newest_acked == NULL || SEQ_LT(newest_acked->seq_num, seq)) newest_acked = slot;
+      }
+   }
+
+   //? Mesure du RTT (règle de Karn : jamais sur un PDU retransmis)
+   if (newest_acked != NULL && newest_acked->transmissions == 1) {
+      rtt_sample(socket, get_now_time_usec() - newest_acked->sent_time);
+   }
+   cc_ack(socket, newly_acked, cumulative);
+   //? Le puits a dépassé la base annoncée : le FORWARD est confirmé
+   if (forward_time[socket] != 0 && SEQ_LEQ(forward_base[socket], cumulative)) forward_time[socket] = 0;
+   TRACE(TRACE_ACK_RECEIVED, socket, cumulative, nb_blocks, newly_acked);
+
+   //? Détection des trous : on remonte la fenêtre en comptant les PDU acquittés au-dessus
+   if (nb_blocks > 0) {
+      int acked_above = 0;
+      for (unsigned int seq = next - 1; SEQ_LEQ(window->base, seq); seq--) {
+         send_slot_t *slot = &window->slots[seq % SEND_WINDOW_SIZE];
+         if (slot->state == SLOT_ACKED) {
+            acked_above++;
+         } else if (slot->state == SLOT_IN_FLIGHT && acked_above >= DUP_THRESH && !slot->fast_retransmitted) {
+            slot->fast_retransmitted = 1;
+            cc_loss(socket, seq);
+            if (handle_lost_slot(socket, slot) == -1) return -1;
+         }
+      }
+   }
+   advance_send_window(socket);
+   //? L'ACK a libéré de la place dans la fenêtre de congestion
+   try_transmit(socket);
+   return 0;
+}
+
+/*
+ * Parcourt les PDU en vol et traite ceux dont le timer a expiré :
+ * seul le PDU perdu est retransmis, ou abandonné si le taux de perte le permet
+ * Retourne -1 en cas d'erreur d'envoi, 0 sinon
+ */
+int check_retransmissions(int socket) {
+   send_window_t *window = &send_window[socket];
+   unsigned long now = get_now_time_usec();
+
+   for (unsigned int seq = window->base; seq != window->next_to_send; seq++) {
+      send_slot_t *slot = &window->slots[seq % SEND_WINDOW_SIZE];
+      if (slot->state != SLOT_IN_FLIGHT || now - slot->sent_time < rtt_estimator[socket].rto) continue;
+      TRACE(TRACE_RTO_EXPIRED, socket, seq, window->base, rtt_estimator[socket].rto);
+      if (rto_backoff(socket, slot->sent_time)) cc_timeout(socket);
+      if (handle_lost_slot(socket, slot) == -1) return -1;
+   }
+   //? FORWARD perdu (ou puits qui n'a pas pu tout délivrer) : il est renvoyé avec la base courante
+   if (forward_time[socket] != 0 && now - forward_time[socket] >= rtt_estimator[socket].rto) forward_pending[socket] = 1;
+   advance_send_window(socket);
+   // Les PDU abandonnés ont libéré la fenêtre de congestion
+   try_transmit(socket);
+   return 0;
+}
+
+/*
+ * Expiration du timer de retransmission d'un socket (appelée par le thread protocole)
+ */
+void rto_timer_expired(void *arg) {
+   int socket = (int) (intptr_t) arg;
+   pthread_mutex_lock(&socket_list[socket].mutex);
+   if (socket_list[socket].state == ESTABLISHED) check_retransmissions(socket);
+   pthread_mutex_unlock(&socket_list[socket].mutex);
+}
+
+/*
+ * Expiration du délai de regroupement d'un socket (appelée par le thread protocole) :
+ * le PDU incomplet part sans attendre la fin des PDU en vol
+ */
+void coalesce_timer_expired(void *arg) {
+   int socket = (int) (intptr_t) arg;
+   pthread_mutex_lock(&socket_list[socket].mutex);
+   if (socket_list[socket].state == ESTABLISHED && !corked[socket]) {
+      flush_requested[socket] = 1;
+      try_transmit(socket);
+   }
+   pthread_mutex_unlock(&socket_list[socket].mutex);
+}
+
+//!     ___________________________
+//!    |_PARTIE_FENETRE_RECEPTION_| (réordonnancement et SACK, structure définie dans mictcp.h)
+
+/*
+ * Réinitialise le tampon de réordonnancement d'un socket et rend au pool les PDU conservés
+ */
+void reset_recv_window(int socket) {
+   recv_window_t *window = &recv_window[socket];
+   for (int i = 0; i < RECV_WINDOW_SIZE; i++) {
+      pool_put(window->slots[i].buf);
+   }
+   memset(window, 0, sizeof(recv_window_t));
+}
+
+/*
+ * Délivre à l'application les PDU conservés à partir du prochain numéro attendu,
+ * jusqu'au premier trou. Si la file de réception de l'application est pleine,
+ * le PDU reste dans le tampon et n'est pas acquitté : la source le renverra
+ */
+void deliver_in_order(int fd) {
+   recv_window_t *window = &recv_window[fd];
+   recv_slot_t *slot = &window->slots[expected_sequence[fd] % RECV_WINDOW_SIZE];
+   while (slot->present) {
+      mic_tcp_payload payload = { slot->data, slot->size };
+      if (deliver_payload(fd, payload) == -1) return;
+      slot->present = 0;
+      pool_put(slot->buf);
+      slot->buf = NULL;
+      expected_sequence[fd]++; // On incrémente le numéro de séquence du prochain PDU attendu
+      slot = &window->slots[expected_sequence[fd] % RECV_WINDOW_SIZE];
+   }
+}
+
+/*
+ * La source n'attend plus rien avant base : les PDU conservés avant base sont
+ * délivrés, les trous (PDU abandonnés, perte acceptée) sont sautés
+ */
+void skip_to(int fd, unsigned int base) {
+   recv_window_t *window = &recv_window[fd];
+   if (SEQ_LEQ(base, expected_sequence[fd])) return;
+   //? La base de la source ne peut pas précéder de plus que ses deux fenêtres le prochain PDU
+   //? attendu : une valeur plus lointaine est invalide et n'est pas parcourue
+   if (base - expected_sequence[fd] > SEND_WINDOW_SIZE + RECV_WINDOW_SIZE) return;
+   LOG_DEBUG("[MIC-TCP] Socket %d: la source a résolu les PDU jusqu'à %u, saut des PDU abandonnés\n", fd, base - 1);
+   while (SEQ_LT(expected_sequence[fd], base)) {
+      recv_slot_t *slot = &window->slots[expected_sequence[fd] % RECV_WINDOW_SIZE];
+      if (slot->present) {
+         mic_tcp_payload payload = { slot->data, slot->size };
+         if (deliver_payload(fd, payload) == -1) return; // File pleine, on reprendra au prochain PDU
+         slot->present = 0;
+         pool_put(slot->buf);
+         slot->buf = NULL;
+      } else {
+         counters[fd].segments_skipped++;
+      }
+      expected_sequence[fd]++;
+   }
+   deliver_in_order(fd);
+}
+
+/*
+ * Conserve un PDU de données reçu dans le tampon de réordonnancement
+ * Les données ne sont pas copiées : le PDU est dans un tampon du pool
+ * (voir listening()), on en garde une référence jusqu'à sa délivrance
+ * Retourne 1 si le PDU est nouveau, 0 s'il est dupliqué ou hors de la fenêtre
+ */
+int store_received_pdu(int fd, mic_tcp_pdu *pdu) {
+   unsigned int seq = pdu->header.seq_num;
+   // Déjà délivré, ou trop loin devant le prochain PDU attendu
+   if (SEQ_LT(seq, expected_sequence[fd]) || seq - expected_sequence[fd] >= RECV_WINDOW_SIZE) return 0;
+
+   recv_slot_t *slot = &recv_window[fd].slots[seq % RECV_WINDOW_SIZE];
+   if (slot->present) return 0;
+   slot->buf = pool_buf_of(pdu->payload.data);
+   pool_ref(slot->buf);
+   slot->data = pdu->payload.data;
+   slot->size = min_size(pdu->payload.size, MAX_PAYLOAD_SIZE);
+   slot->present = 1;
+   return 1;
+}
+
+/*
+ * Retourne 1 si des PDU sont conservés au-delà du prochain PDU attendu (trou à signaler)
+ */
+int recv_window_holds(int fd) {
+   recv_window_t *window = &recv_window[fd];
+   for (unsigned int i = 1; i < RECV_WINDOW_SIZE; i++) {
+      if (window->slots[(expected_sequence[fd] + i) % RECV_WINDOW_SIZE].present) return 1;
+   }
+   return 0;
+}
+
+/*
+ * Construit les blocs SACK décrivant les PDU conservés au-delà du prochain PDU attendu
+ * Retourne le nombre de blocs écrits dans blocks
+ */
+int build_sack_blocks(int fd, mic_tcp_sack_block *blocks) {
+   recv_window_t *window = &recv_window[fd];
+   int nb_blocks = 0, in_block = 0;
+   for (unsigned int i = 1; i < RECV_WINDOW_SIZE && nb_blocks < MAX_SACK_BLOCKS; i++) {
+      unsigned int seq = expected_sequence[fd] + i;
+      int present = window->slots[seq % RECV_WINDOW_SIZE].present;
+      if (present && !in_block) {
+         blocks[nb_blocks].start = seq;
+         in_block = 1;
+      } else if (!present && in_block) {
+         blocks[nb_blocks++].end = seq;
+         in_block = 0;
+      }
+   }
+   if (in_block) blocks[nb_blocks++].end = expected_sequence[fd] + RECV_WINDOW_SIZE;
+   return nb_blocks;
+}
+
+//!     _______________________
+//!    |_PARTIE_ACQUITTEMENT_| (appelée avec le mutex du socket verrouillé)
+
+/*
+ * Envoie l'ACK cumulatif des données : seq_num indique le prochain PDU attendu,
+ * les blocs SACK décrivent les PDU conservés au-delà
+ */
+void send_data_ack(int fd) {
+   mic_tcp_pdu pdu_ack;
+   mic_tcp_sack_block sack_blocks[MAX_SACK_BLOCKS];
+   pdu_ack.header.source_port = socket_list[fd].local_addr.port;
+   pdu_ack.header.dest_port = socket_list[fd].remote_addr.port;
+   pdu_ack.header.seq_num = expected_sequence[fd];
+   pdu_ack.header.ack_num = build_sack_blocks(fd, sack_blocks);
+   pdu_ack.header.ack = 1;
+   pdu_ack.header.syn = 0;
+   pdu_ack.header.fin = 0;
+   pdu_ack.header.fwd = 0;
+   pdu_ack.payload.data = (char *) sack_blocks;
+   pdu_ack.payload.size = pdu_ack.header.ack_num * sizeof(mic_tcp_sack_block);
+   IP_send(pdu_ack, socket_list[fd].remote_addr.ip_addr); // Envoi de l'ACK
+   TRACE(TRACE_ACK_SENT, fd, expected_sequence[fd], pdu_ack.header.ack_num, pending_acks[fd]);
+
+   pending_acks[fd] = 0;
+   counters[fd].acks_sent++;
+   timer_cancel(&ack_timer[fd]);
+}
+
+/*
+ * Acquitte un PDU de données reçu : immédiatement, ou en retardant l'ACK (option
+ * MIC_TCP_ACK_EVERY) jusqu'au N-ième PDU ou à l'expiration de ack_delay
+ * in_order vaut 1 si le PDU était le prochain attendu et a été délivré seul
+ */
+void ack_received_pdu(int fd, int in_order) {
+   counters[fd].segments_received++;
+   pending_acks[fd]++;
+   //? Hors séquence, doublon, trou comblé ou PDU encore retenus au-delà d'un trou :
+   //? la source doit être informée sans attendre pour réparer vite ses pertes
+   if (!in_order || pending_acks[fd] >= ack_every[fd] || recv_window_holds(fd)) {
+      send_data_ack(fd);
+   } else if (!timer_is_armed(&ack_timer[fd])) {
+      timer_arm(&ack_timer[fd], get_now_time_usec() + ack_delay[fd]);
+   }
+}
+
+/*
+ * Expiration du délai d'ACK d'un socket (appelée par le thread protocole)
+ */
+void ack_timer_expired(void *arg) {
+   int fd = (int) (intptr_t) arg;
+   pthread_mutex_lock(&socket_list[fd].mutex);
+   if (socket_list[fd].state == ESTABLISHED && pending_acks[fd] > 0) {
+      counters[fd].delayed_acks++;
+      send_data_ack(fd);
+   }
+   pthread_mutex_unlock(&socket_list[fd].mutex);
+}
+
+//!     _________________________________
+//!    |_PARTIE_ETABLISSEMENT_CONNEXION_| (appelée avec le mutex du socket verrouillé)
+
+/*
+ * Envoie (ou renvoie) le SYN du client et arme le timer du handshake
+ * Le client transmet le taux acceptable de perte dans le champ ack_num du SYN
+ */
+void send_syn(int socket) {
+   mic_tcp_pdu pdu_syn;
+   pdu_syn.header.source_port = socket_list[socket].local_addr.port;
+   pdu_syn.header.dest_port = socket_list[socket].remote_addr.port;
+   pdu_syn.header.seq_num = next_sequence[socket];
+   pdu_syn.header.ack_num = acceptable_loss_rate[socket]; // Taux de perte proposé
+   pdu_syn.header.syn = 1;
+   pdu_syn.header.ack = 0;
+   pdu_syn.header.fin = 0;
+   pdu_syn.header.fwd = 0;
+   pdu_syn.payload.size = 0;
+
+   LOG_INFO("[MIC-TCP] Envoi du SYN pour établir la connexion sur le socket %d\n", socket);
+   handshake[socket].sent_time = get_now_time_usec();
+   handshake[socket].attempts++;
+   // En cas d'erreur d'envoi, le SYN sera renvoyé à l'expiration du timer
+   IP_send(pdu_syn, socket_list[socket].remote_addr.ip_addr);
+   timer_arm(&handshake_timer[socket], handshake[socket].sent_time + rtt_estimator[socket].rto);
+}
+
+/*
+ * Envoie (ou renvoie) le SYN-ACK du serveur et arme le timer du handshake
+ */
+void send_syn_ack(int socket) {
+   mic_tcp_pdu pdu_syn_ack;
+   pdu_syn_ack.header.source_port = socket_list[socket].local_addr.port;
+   pdu_syn_ack.header.dest_port = socket_list[socket].remote_addr.port;
+   pdu_syn_ack.header.seq_num = expected_sequence[socket];
+   pdu_syn_ack.header.ack_num = acceptable_loss_rate[socket]; // Taux de perte retenu pour la connexion
+   pdu_syn_ack.header.syn = 1;
+   pdu_syn_ack.header.ack = 1;
+   pdu_syn_ack.header.fin = 0;
+   pdu_syn_ack.header.fwd = 0;
+   pdu_syn_ack.payload.size = 0;
+
+   LOG_DEBUG("[MIC-TCP] Envoi du SYN-ACK pour le socket %d\n", socket);
+   handshake[socket].sent_time = get_now_time_usec();
+   handshake[socket].attempts++;
+   IP_send(pdu_syn_ack, socket_list[socket].remote_addr.ip_addr);
+   timer_arm(&handshake_timer[socket], handshake[socket].sent_time + rtt_estimator[socket].rto);
+}
+
+/*
+ * Envoie l'ACK qui termine l'établissement de connexion côté client
+ */
+void send_handshake_ack(int socket) {
+   mic_tcp_pdu pdu_ack;
+   pdu_ack.header.source_port = socket_list[socket].local_addr.port;
+   pdu_ack.header.dest_port = socket_list[socket].remote_addr.port;
+   pdu_ack.header.seq_num = next_sequence[socket];
+   pdu_ack.header.ack_num = 0;
+   pdu_ack.header.syn = 0;
+   pdu_ack.header.ack = 1;
+   pdu_ack.header.fin = 0;
+   pdu_ack.header.fwd = 0;
+   pdu_ack.payload.size = 0;
+   IP_send(pdu_ack, socket_list[socket].remote_addr.ip_addr);
+}
+
+/*
+ * Passe le socket en état ESTABLISHED et réveille le thread en attente
+ * Le handshake fournit la première mesure de RTT si le SYN (ou SYN-ACK) n'a pas été répété
+ */
+void handshake_done(int socket) {
+   timer_cancel(&handshake_timer[socket]);
+   if (handshake[socket].attempts == 1) rtt_sample(socket, get_now_time_usec() - handshake[socket].sent_time);
+   socket_list[socket].state = ESTABLISHED;
+   pthread_cond_broadcast(&socket_list[socket].cond);
+   notify_socket(socket);
+   LOG_INFO("[MIC-TCP] Connexion établie pour le socket %d\n", socket);
+   TRACE(TRACE_ESTABLISHED, socket, next_sequence[socket], expected_sequence[socket], socket_list[socket].remote_addr.port);
+
+   //? Connexion créée par un socket en écoute : elle rejoint sa file d'acceptation
+   int listener = listener_of[socket];
+   if (listener != -1) {
+      pthread_mutex_lock(&socket_list[listener].mutex);
+      accept_next[socket] = -1;
+      if (accept_tail[listener] == -1) accept_head[listener] = socket;
+      else accept_next[accept_tail[listener]] = socket;
+      accept_tail[listener] = socket;
+      pthread_cond_broadcast(&socket_list[listener].cond);
+      notify_socket(listener);
+      pthread_mutex_unlock(&socket_list[listener].mutex);
+   }
+}
+
+/*
+ * Retire de la file d'acceptation de son socket en écoute une connexion fermée
+ * avant que mic_tcp_accept() ne la récupère
+ * Appelée avec le mutex de la connexion verrouillé (même ordre que handshake_done())
+ */
+void accept_queue_remove(int socket) {
+   int listener = listener_of[socket];
+   if (listener == -1) return;
+   pthread_mutex_lock(&socket_list[listener].mutex);
+   int previous = -1;
+   for (int fd = accept_head[listener]; fd != -1; previous = fd, fd = accept_next[fd]) {
+      if (fd != socket) continue;
+      if (previous == -1) accept_head[listener] = accept_next[fd];
+      else accept_next[previous] = accept_next[fd];
+      if (accept_tail[listener] == fd) accept_tail[listener] = previous;
+      break;
+   }
+   pthread_mutex_unlock(&socket_list[listener].mutex);
+   listener_of[socket] = -1;
+}
+
+/*
+ * Expiration du timer du handshake : le SYN ou le SYN-ACK est renvoyé avec un RTO doublé
+ */
+void handshake_timer_expired(void *arg) {
+   int socket = (int) (intptr_t) arg;
+   pthread_mutex_lock(&socket_list[socket].mutex);
+   if (socket_list[socket].state == SYN_SENT) {
+      rto_backoff(socket, handshake[socket].sent_time);
+      send_syn(socket);
+   } else if (socket_list[socket].state == SYN_RECEIVED) {
+      rto_backoff(socket, handshake[socket].sent_time);
+      send_syn_ack(socket);
+   }
+   pthread_mutex_unlock(&socket_list[socket].mutex);
+}
+
+//!     __________________________
+//!    |_PARTIE_THREAD_PROTOCOLE_|
+
+/*
+ * Thread protocole : dort jusqu'à la prochaine échéance de la roue des timers
+ * (retransmission, handshake) puis appelle les timers échus.
+ * La réception est assurée par le thread de mictcp_core, dans les deux modes
+ */
+void* protocol_thread(void* arg) {
+   while (1) {
+      timer_wheel_run(get_now_time_usec());
+      timer_wheel_wait();
+   }
+   return NULL;
+}
+
+//!     _______________________
+//!    |_PARTIE_VERIFICATIONS_|
+
+/*
+ * Fonction de vérification de la validité d'un socket
+ * Retourne 0 si le socket est valide, -1 sinon
+ */
+int verif_socket(int socket) {
+   if (socket < 0 || socket >= MAX_SOCKETS || !socket_list[socket].in_use) {
+      LOG_ERROR("[MIC-TCP] Erreur: Socket invalide\n");
+      return -1;
+   }
+   return 0;
+}
+
+/*
+ * Fonction de vérification de la validité d'une adresse
+ * Retourne 0 si l'adresse est valide, -1 sinon
+ */
+int verif_address(mic_tcp_sock_addr addr) {
+   // Vérifie que le port est valide (> 1024)
+   if (addr.port <= 1024) return -1;
+
+   if(strstr(addr.ip_addr.addr, "localhost")) return 0; // Si l'adresse est "localhost", on considère que c'est valide
+
+   // Vérifie que la taille de l'adresse IP est non nulle
+   if (addr.ip_addr.addr_size == 0 || addr.ip_addr.addr == NULL) return -1;
+
+   // On copie l'adresse IP
+   char ip_copy[addr.ip_addr.addr_size + 1];
+   strncpy(ip_copy, addr.ip_addr.addr, addr.ip_addr.addr_size);
+   ip_copy[addr.ip_addr.addr_size] = '\0'; // Ajoute le caractère de fin de chaîne
+
+   // Compte le nombre de segments dans l'adresse IP
+   int segments = 0;
+   char* token = strtok(ip_copy, "."); // On découpe l'adresse IP en segments
+
+   while (token != NULL) {
+      // Convertit le segment en entier
+      char* endptr;
+      long value = strtol(token, &endptr, 10);
+
+      // Vérifie que la conversion est valide et dans l'intervalle 0-255
+      if (*endptr != '\0' || value < 0 || value > 255) return -1;
+
+      segments++;
+      token = strtok(NULL, ".");
+   }
+
+   // Vérifie qu'on a exactement 4 segments (X.X.X.X) pour IPv4
+   if (segments != 4) return -1;
+
+   return 0;
+}
+
+//!     _______________________________
+//!    |_PARTIE_FONCTIONS_PRINCIPALES_|
+
+/*
+ * Attribue et initialise un descripteur libre (les descripteurs des sockets fermés sont réutilisés)
+ * Utilisée par mic_tcp_socket() et pour les connexions reçues par un socket en écoute
+ * Retourne le descripteur ou bien -1 si la liste de sockets est pleine
+ */
+int alloc_socket(void) {
+   pthread_mutex_lock(&socket_list_lock);
+   //? Recherche d'un descripteur libre (les descripteurs des sockets fermés sont réutilisés)
+   int socket = -1;
+   for (int i = 0; i < MAX_SOCKETS; i++) {
+      if (!socket_list[i].in_use) {
+         socket = i;
+         break;
+      }
+   }
+   // Verifie si la liste de sockets est pleine
+   if (socket == -1) {
+      pthread_mutex_unlock(&socket_list_lock);
+      return -1;
+   }
+   if (socket >= last_used_socket) {
+      pthread_mutex_init(&socket_list[socket].mutex, NULL);
+      pthread_cond_init(&socket_list[socket].cond, NULL);
+      last_used_socket = socket + 1;
+   }
+
+   pthread_mutex_lock(&socket_list[socket].mutex);
+   socket_list[socket].in_use = 1;
+   socket_list[socket].fd = socket;
+   socket_list[socket].state = CLOSED;
+   memset(&socket_list[socket].local_addr, 0, sizeof(mic_tcp_sock_addr));
+   memset(&socket_list[socket].remote_addr, 0, sizeof(mic_tcp_sock_addr));
+   pthread_mutex_unlock(&socket_list_lock);
+
+   // Initialiser la fenêtre glissante pour ce socket
+   next_sequence[socket] = 0;
+   expected_sequence[socket] = 0;
+   loss_window[socket].total = 0;
+   init_a_sliding_window(socket, WINDOW_SIZE, 0);
+   reset_send_window(socket);
+   reset_recv_window(socket);
+   init_rtt_estimator(socket);
+   init_congestion(socket, MIC_TCP_CC_RENO);
+   memset(&handshake[socket], 0, sizeof(handshake_t));
+   timer_init(&rto_timer[socket], rto_timer_expired, (void *) (intptr_t) socket);
+   timer_init(&handshake_timer[socket], handshake_timer_expired, (void *) (intptr_t) socket);
+   timer_init(&coalesce_timer[socket], coalesce_timer_expired, (void *) (intptr_t) socket);
+   timer_init(&ack_timer[socket], ack_timer_expired, (void *) (intptr_t) socket);
+   listener_of[socket] = -1;
+   accept_head[socket] = accept_tail[socket] = -1;
+   nonblocking[socket] = 0;
+   stream_mode[socket] = 0;
+   acceptable_loss_rate[socket] = DEFAULT_ACCEPTABLE_LOSS;
+   coalesce_delay[socket] = 0;
+   corked[socket] = 0;
+   flush_requested[socket] = 0;
+   ack_every[socket] = 1;
+   ack_delay[socket] = DEFAULT_ACK_DELAY;
+   pending_acks[socket] = 0;
+   message_lifetime[socket] = 0;
+   linger_time[socket] = DEFAULT_LINGER;
+   forward_pending[socket] = 0;
+   forward_time[socket] = 0;
+   memset(&counters[socket], 0, sizeof(socket_counters_t));
+   event_watched[socket] = 0;
+   cq_head[socket] = cq_tail[socket] = 0;
+   posted_head[socket] = posted_tail[socket] = 0;
+   async_pending[socket] = 0;
+   if (event_fd[socket] > 0) {
+      uint64_t count; // Vide un signal laissé par le socket précédent
+      if (read(event_fd[socket], &count, sizeof(count)) == -1) count = 0;
+   }
+   pthread_mutex_unlock(&socket_list[socket].mutex);
+   if (app_buffer_open(socket) == -1) {
+      pthread_mutex_lock(&socket_list_lock);
+      socket_list[socket].in_use = 0;
+      pthread_mutex_unlock(&socket_list_lock);
+      return -1;
+   }
+   return socket;
+}
+
+/*
+ * Permet de créer un socket entre l’application et MIC-TCP
+ * Retourne le descripteur du socket ou bien -1 en cas d'erreur
+ */
+int mic_tcp_socket(start_mode sm){
+   int result = -1;
+   print_func_name(__FUNCTION__);
+   result = initialize_components(sm); /* Appel obligatoire */
+   set_loss_rate(real_loss_rate); /* On initialise le taux de perte, c'est la fonction IP_send() qui gère */
+   if (result == -1) return -1;
+
+   //? Démarrage du thread protocole à la création du premier socket
+   pthread_mutex_lock(&socket_list_lock);
+   if (!protocol_started) {
+      //? Trace binaire demandée par l'environnement, un fichier par processus
+      const char* trace_path = getenv("MIC_TCP_TRACE");
+      if (trace_path != NULL) {
+         char path[256];
+         snprintf(path, sizeof(path), "%s.%d", trace_path, (int) getpid());
+         trace_open(path);
+      }
+      //? Export des statistiques demandé par l'environnement
+      const char* stats_name = getenv("MIC_TCP_STATS");
+      if (stats_name != NULL) {
+         char name[256];
+         snprintf(name, sizeof(name), "%s.%d", stats_name, (int) getpid());
+         mic_tcp_stats_export(name, 0);
+      }
+      if (pthread_create(&protocol_th, NULL, protocol_thread, NULL) != 0) {
+         pthread_mutex_unlock(&socket_list_lock);
+         return -1;
+      }
+      protocol_started = 1;
+   }
+   pthread_mutex_unlock(&socket_list_lock);
+
+   // Retourne le descripteur du socket ou -1 en cas d'erreur
+   return alloc_socket();
+}
+
+/*
+ * Permet d’attribuer une adresse à un socket.
+ * Retourne 0 si succès, et -1 en cas d’échec
+ */
+int mic_tcp_bind(int socket, mic_tcp_sock_addr addr) {
+   print_func_name(__FUNCTION__);
+   
+   //Vérifie si le socket est valide et si l'adresse est valide
+   if (verif_socket(socket) == 0) {
+      // Attribue addr au socket (sous le verrou de la liste, lue par assign_ephemeral_port())
+      pthread_mutex_lock(&socket_list_lock);
+      pthread_mutex_lock(&socket_list[socket].mutex);
+      socket_list[socket].local_addr = addr; /* On attribue l'adresse au socket */
+      pthread_mutex_unlock(&socket_list[socket].mutex);
+      pthread_mutex_unlock(&socket_list_lock);
+      LOG_INFO("[MIC-TCP] Socket %d lié à l'adresse %s:%d\n", socket, addr.ip_addr.addr, addr.port);
+      return 0;
+   }
+   return -1;
+}
+
+/*
+ * Met le socket en état d'acceptation de connexions et attend une connexion.
+ * Chaque SYN reçu sur le port du socket crée une nouvelle connexion (son propre
+ * descripteur), mise en file une fois le handshake terminé ; le socket reste en écoute
+ * Retourne le descripteur de la connexion établie, -1 si erreur
+ */
+int mic_tcp_accept(int socket, mic_tcp_sock_addr* addr) {
+   print_func_name(__FUNCTION__);
+   
+   // Vérifie si le socket est valide
+   if (verif_socket(socket) == -1) return -1;
+   
+   // On utilise un mutex et une condition pour attendre que la connexion soit établie
+   pthread_mutex_lock(&socket_list[socket].mutex);
+
+   //? Met le socket en état d'acceptation de connexions
+   if (socket_list[socket].state == CLOSED) {
+      if (listener_insert(socket_list[socket].local_addr.port, socket) == -1) {
+         LOG_ERROR("[MIC-TCP] Erreur: un socket écoute déjà sur le port %d\n", socket_list[socket].local_addr.port);
+         pthread_mutex_unlock(&socket_list[socket].mutex);
+         return -1;
+      }
+      socket_list[socket].state = IDLE; // On change l'état du socket
+   }
+   if (socket_list[socket].state != IDLE) {
+      pthread_mutex_unlock(&socket_list[socket].mutex);
+      return -1;
+   }
+   LOG_INFO("[MIC-TCP] Socket %d en attente de connexion...\n", socket);
+
+   int connection = -1;
+   while (connection == -1) {
+      //? En mode non bloquant, le socket est mis en écoute et l'appel retourne tout de suite
+      if (nonblocking[socket] && accept_head[socket] == -1) {
+         pthread_mutex_unlock(&socket_list[socket].mutex);
+         errno = EAGAIN;
+         return -1;
+      }
+
+      //? Attente passive jusqu'à ce qu'une connexion soit établie
+      while(socket_list[socket].state == IDLE && accept_head[socket] == -1) {
+         // Le thread se bloque jusqu'à ce qu'il soit réveillé
+         pthread_cond_wait(&socket_list[socket].cond, &socket_list[socket].mutex);
+      }
+      connection = accept_head[socket];
+      if (connection != -1) {
+         accept_head[socket] = accept_next[connection];
+         if (accept_head[socket] == -1) accept_tail[socket] = -1;
+      }
+      pthread_mutex_unlock(&socket_list[socket].mutex);
+      if (connection == -1) return -1; // Socket fermé pendant l'attente
+
+      pthread_mutex_lock(&socket_list[connection].mutex);
+      int closed = listener_of[connection] != socket;
+      if (!closed) {
+         listener_of[connection] = -1;
+         if (addr != NULL) *addr = socket_list[connection].remote_addr;
+      }
+      pthread_mutex_unlock(&socket_list[connection].mutex);
+      //? La connexion a pu être fermée entre sa sortie de file et son verrou : on attend la suivante
+      if (closed) {
+         connection = -1;
+         pthread_mutex_lock(&socket_list[socket].mutex);
+      }
+   }
+
+   LOG_INFO("[MIC-TCP] Connexion acceptée sur le socket %d (descripteur %d)\n", socket, connection);
+   return connection; // Retourne le descripteur de la connexion établie
+}
+
+/*
+ * Attribue un port local libre au socket d'un client qui n'a pas appelé mic_tcp_bind(),
+ * pour que process_received_PDU() distingue les connexions d'un même processus
+ * Retourne 0 si succès, -1 si aucun port n'est libre
+ */
+int assign_ephemeral_port(int socket) {
+   pthread_mutex_lock(&socket_list_lock);
+   for (int attempt = 0; attempt <= EPHEMERAL_PORT_MAX - EPHEMERAL_PORT_MIN; attempt++) {
+      unsigned short port = next_ephemeral_port;
+      next_ephemeral_port = port == EPHEMERAL_PORT_MAX ? EPHEMERAL_PORT_MIN : port + 1;
+      int used = 0;
+      for (int i = 0; i < last_used_socket && !used; i++) {
+         used = socket_list[i].in_use && socket_list[i].local_addr.port == port;
+      }
+      if (!used) {
+         socket_list[socket].local_addr.port = port;
+         pthread_mutex_unlock(&socket_list_lock);
+         LOG_INFO("[MIC-TCP] Socket %d: port local %d attribué\n", socket, port);
+         return 0;
+      }
+   }
+   pthread_mutex_unlock(&socket_list_lock);
+   return -1;
+}
+
+/*
+ * Permet de réclamer l’établissement d’une connexion
+ * Le SYN est renvoyé par le thread protocole à chaque expiration du RTO
+ * Retourne 0 si la connexion est établie, et -1 en cas d’échec
+ */
+int mic_tcp_connect(int socket, mic_tcp_sock_addr addr) {
+   print_func_name(__FUNCTION__);
+   // Vérifie si le socket est valide et si l'adresse est valide
+   if (verif_socket(socket) == -1 || verif_address(addr) == -1) return -1;
+   if (socket_list[socket].local_addr.port == 0 && assign_ephemeral_port(socket) == -1) return -1;
+
+   //? Enregistrement de la connexion pour le démultiplexage des PDU reçus
+   demux_key_t key;
+   struct sockaddr_in remote_ip;
+   if (IP_resolve(addr.ip_addr.addr, &remote_ip) == -1) return -1;
+   key.local_port = socket_list[socket].local_addr.port;
+   key.remote_ip = remote_ip.sin_addr.s_addr;
+   key.remote_udp_port = remote_ip.sin_port;
+   key.remote_port = addr.port;
+
+   pthread_mutex_lock(&socket_list[socket].mutex);
+   if (socket_list[socket].state != CLOSED || demux_insert(key, socket) == -1) {
+      pthread_mutex_unlock(&socket_list[socket].mutex);
+      return -1;
+   }
+   // Assigner l'adresse distante au socket
+   socket_list[socket].remote_addr = addr;
+   socket_list[socket].state = SYN_SENT;
+   memset(&handshake[socket], 0, sizeof(handshake_t));
+
+   //? Envoi du SYN, le SYN-ACK est traité par process_received_PDU()
+   send_syn(socket);
+
+   //? Attente passive jusqu'à ce que la connexion soit établie
+   while (socket_list[socket].state != ESTABLISHED) {
+      pthread_cond_wait(&socket_list[socket].cond, &socket_list[socket].mutex);
+   }
+   pthread_mutex_unlock(&socket_list[socket].mutex);
+
+   LOG_INFO("[MIC-TCP] Connexion établie avec succès sur le socket %d\n", socket);     
+   return 0;
+}
+
+/*
+ * Copie le message dans l'emplacement du numéro de séquence courant de la fenêtre
+ * d'émission (qui doit avoir de la place) et l'envoie si la fenêtre de congestion le permet
+ * Appelée avec le mutex du socket verrouillé
+ * Retourne 0, ou -1 si aucun tampon n'est disponible
+ */
+int queue_pdu(int socket, char* mesg, int mesg_size, int async, void* user_data, unsigned long deadline) {
+   send_window_t *window = &send_window[socket];
+
+   //! Copie du message dans l'emplacement du numéro de séquence courant
+   send_slot_t *slot = &window->slots[next_sequence[socket] % SEND_WINDOW_SIZE];
+   slot->buf = pool_alloc();
+   if (slot->buf == NULL) return -1;
+   memcpy(slot->buf->data, mesg, mesg_size);
+   slot->size = mesg_size;
+   slot->seq_num = next_sequence[socket]; // Numéro de séquence du PDU
+   slot->state = SLOT_QUEUED;
+   slot->transmissions = 0;
+   slot->in_loss_window = 0;
+   slot->fast_retransmitted = 0;
+   slot->async = async;
+   slot->user_data = user_data;
+   slot->deadline = deadline;
+   next_sequence[socket]++; // On incrémente le numéro de séquence du prochain PDU à émettre
+
+   //? Envoi sur la couche IP si la fenêtre de congestion le permet
+   try_transmit(socket);
+   return 0;
+}
+
+/*
+ * Permet de réclamer l’envoi d’une donnée applicative, de taille quelconque :
+ * elle est découpée en PDU d'au plus MAX_PAYLOAD_SIZE octets.
+ * Chaque PDU est placé dans la fenêtre d'émission et envoyé dès que la fenêtre de
+ * congestion le permet ; les ACK et retransmissions sont traités par les autres threads.
+ * L'appel ne bloque que si SEND_WINDOW_SIZE PDU occupent déjà la fenêtre d'émission
+ * (en mode non bloquant, seuls les PDU qui y trouvent place sont envoyés)
+ * Avec MIC_TCP_COALESCE ou MIC_TCP_CORK, les octets complètent d'abord le dernier PDU
+ * pas encore envoyé : le flux d'octets reçu est le même, mais pas le découpage en messages
+ * Retourne la taille des données envoyées, et -1 en cas d'erreur
+ */
+int mic_tcp_send (int mic_sock, char* mesg, int mesg_size) {
+   print_func_name(__FUNCTION__);
+
+   // Vérifie si le socket est valide
+   if (verif_socket(mic_sock) == -1) return -1;
+   if (mesg_size < 0) return -1;
+
+   send_window_t *window = &send_window[mic_sock];
+   int sent = 0, pdus = 0;
+   pthread_mutex_lock(&socket_list[mic_sock].mutex);
+   unsigned long deadline = message_deadline(mic_sock);
+
+   //? Un message vide donne tout de même un PDU
+   do {
+      //? Regroupement : le dernier PDU en attente est complété avant d'en créer un autre
+      send_slot_t *tail = coalescing_tail(mic_sock);
+      if (tail != NULL && sent < mesg_size) {
+         int chunk = min_size(mesg_size - sent, MAX_PAYLOAD_SIZE - tail->size);
+         memcpy(tail->buf->data + tail->size, mesg + sent, chunk);
+         tail->size += chunk;
+         tail->deadline = merge_deadlines(tail->deadline, deadline);
+         sent += chunk;
+         counters[mic_sock].coalesced_writes++;
+         if (tail->size == MAX_PAYLOAD_SIZE) try_transmit(mic_sock); // PDU complet
+         continue;
+      }
+      //? Attente d'une place dans la fenêtre d'émission (sauf en mode non bloquant)
+      if (nonblocking[mic_sock] && socket_list[mic_sock].state == ESTABLISHED && in_flight(mic_sock) >= SEND_WINDOW_SIZE) {
+         errno = EAGAIN;
+         break;
+      }
+      while (socket_list[mic_sock].state == ESTABLISHED && in_flight(mic_sock) >= SEND_WINDOW_SIZE) {
+         pthread_cond_wait(&socket_list[mic_sock].cond, &socket_list[mic_sock].mutex);
+      }
+      if (socket_list[mic_sock].state != ESTABLISHED) break;
+
+      int segment = min_size(mesg_size - sent, MAX_PAYLOAD_SIZE);
+      if (queue_pdu(mic_sock, mesg + sent, segment, 0, NULL, deadline) == -1) break;
+      sent += segment;
+      pdus++;
+   } while (sent < mesg_size);
+
+   LOG_DEBUG("[MIC-TCP] Socket %d: %u PDU dans la fenêtre (base %u, prochain %d)\n", mic_sock, in_flight(mic_sock), window->base, next_sequence[mic_sock]);
+   pthread_mutex_unlock(&socket_list[mic_sock].mutex);
+   //? Une partie des données a pu être envoyée avant une erreur
+   if (pdus == 0 && sent == 0) return -1;
+   return sent; // Retourne la taille des données envoyées
+}
+
+/*
+ * Permet à l’application réceptrice de réclamer la récupération d’une donnée
+ * stockée dans les buffers de réception du socket
+ * Une donnée plus grande que mesg est lue en plusieurs appels (rien n'est perdu).
+ * En mode flux (option MIC_TCP_STREAM), l'appel remplit mesg avec les données
+ * de plusieurs PDU, sans attendre une fois le premier octet reçu
+ * Retourne le nombre d’octets lu ou bien -1 en cas d’erreur
+ * (en mode non bloquant, -1 avec errno à EAGAIN si aucune donnée n'est prête)
+ * NB : cette fonction fait appel à la fonction app_buffer_get()
+ */
+int mic_tcp_recv (int socket, char* mesg, int max_mesg_size) {
+   print_func_name(__FUNCTION__);
+   //verifie si le socket est valide
+   if (verif_socket(socket) == -1) return -1;
+
+   mic_tcp_payload payload;
+   payload.data = mesg; // On met le message dans le payload
+   payload.size = max_mesg_size; // On met la taille du message dans le payload
+   // On lit le message dans la file de réception propre au socket
+   int received = app_buffer_get(socket, payload, !nonblocking[socket]); //retourne le nombre d'octets -1 si erreur
+
+   //? Mode flux : on complète avec ce qui est déjà arrivé
+   while (stream_mode[socket] && received > 0 && received < max_mesg_size) {
+      payload.data = mesg + received;
+      payload.size = max_mesg_size - received;
+      int more = app_buffer_get(socket, payload, 0);
+      if (more <= 0) break;
+      received += more;
+   }
+   return received;
+}
+
+/*
+ * Crée la connexion demandée par un SYN reçu sur le port d'un socket en écoute
+ * et répond par un SYN-ACK ; mic_tcp_accept() la récupère une fois établie
+ */
+void accept_connection(mic_tcp_pdu pdu, mic_tcp_ip_addr remote_addr, demux_key_t key) {
+   int listener = listener_lookup(pdu.header.dest_port);
+   if (listener == -1) {
+      LOG_DEBUG("[MIC-TCP] SYN reçu sur le port %d sans socket en écoute\n", pdu.header.dest_port);
+      return;
+   }
+   int fd = alloc_socket();
+   if (fd == -1) {
+      LOG_ERROR("[MIC-TCP] Erreur: plus de socket disponible pour la connexion\n");
+      return;
+   }
+
+   pthread_mutex_lock(&socket_list[fd].mutex);
+   mic_tcp_sock *sock = &socket_list[fd];
+   LOG_INFO("[MIC-TCP] SYN reçu, envoi du SYN-ACK\n");
+   //? Négociation du taux de perte acceptable : le plus strict du client et du socket en écoute,
+   //? propre à cette connexion
+   acceptable_loss_rate[fd] = min_size(pdu.header.ack_num, acceptable_loss_rate[listener]);
+   LOG_INFO("[MIC-TCP] Taux de perte proposé par le client : %u%%, retenu : %d%%\n", pdu.header.ack_num, acceptable_loss_rate[fd]);
+   //Assigner les adresses au socket (copiée : le tampon de remote_addr est réutilisé)
+   sock->local_addr = socket_list[listener].local_addr;
+   snprintf(remote_ip[fd], IP_ADDR_SIZE, "%s", remote_addr.addr);
+   sock->remote_addr.ip_addr.addr = remote_ip[fd];
+   sock->remote_addr.ip_addr.addr_size = strlen(remote_ip[fd]) + 1;
+   sock->remote_addr.port = pdu.header.source_port;
+   listener_of[fd] = listener;
+   // Hérite des options du socket en écoute
+   rtt_estimator[fd].min_rto = rtt_estimator[listener].min_rto;
+   rtt_estimator[fd].max_rto = rtt_estimator[listener].max_rto;
+   rtt_estimator[fd].rto = clamp_rto(&rtt_estimator[fd], rtt_estimator[fd].rto);
+   init_congestion(fd, congestion[listener].algo);
+   stream_mode[fd] = stream_mode[listener];
+   coalesce_delay[fd] = coalesce_delay[listener];
+   ack_every[fd] = ack_every[listener];
+   ack_delay[fd] = ack_delay[listener];
+   message_lifetime[fd] = message_lifetime[listener];
+   linger_time[fd] = linger_time[listener];
+   init_a_sliding_window(fd, loss_window[listener].size, loss_window[listener].decay);
+
+   if (demux_insert(key, fd) == -1) {
+      // Un autre thread a créé la connexion entre-temps
+      pthread_mutex_unlock(&sock->mutex);
+      pthread_mutex_lock(&socket_list_lock);
+      sock->in_use = 0;
+      pthread_mutex_unlock(&socket_list_lock);
+      return;
+   }
+   sock->state = SYN_RECEIVED;
+   send_syn_ack(fd);
+   pthread_mutex_unlock(&sock->mutex);
+}
+
+/*
+ * Traitement d’un PDU MIC-TCP reçu (mise à jour des numéros de séquence
+ * et d'acquittement, etc.) puis insère les données utiles du PDU dans
+ * le buffer de réception du socket. Cette fonction utilise la fonction
+ * app_buffer_put().
+ */
+void process_received_PDU(mic_tcp_pdu pdu, mic_tcp_ip_addr local_addr, mic_tcp_ip_addr remote_addr) {
+   print_func_name(__FUNCTION__);
+
+   //? Recherche de la connexion du PDU par son quadruplet, en O(1)
+   demux_key_t key;
+   struct sockaddr_in source_ip;
+   if (IP_resolve(remote_addr.addr, &source_ip) == -1) return;
+   key.local_port = pdu.header.dest_port;
+   key.remote_ip = source_ip.sin_addr.s_addr;
+   key.remote_udp_port = source_ip.sin_port;
+   key.remote_port = pdu.header.source_port;
+   int fd = demux_lookup(key);
+
+   //? Un SYN sans connexion existante s'adresse au socket en écoute sur le port
+   if (fd == -1 && pdu.header.syn == 1 && pdu.header.ack == 0) {
+      accept_connection(pdu, remote_addr, key);
+      return;
+   }
+   if (fd == -1) {
+      LOG_DEBUG("[MIC-TCP] PDU non destiné à un de nos sockets\n");
+      return; //on ne fait rien si le PDU n'est pas pour nous
+   }
+
+   pthread_mutex_lock(&socket_list[fd].mutex);
+   mic_tcp_sock *sock = &socket_list[fd];
+   // La connexion a pu être fermée entre la recherche et le verrouillage
+   if (!sock->in_use || sock->state == CLOSED) {
+      pthread_mutex_unlock(&sock->mutex);
+      return;
+   }
+
+   //! Phase d'établissement de connexion
+   //? Si on recoit de nouveau le SYN, le SYN-ACK a été perdu
+   if (pdu.header.syn == 1 && pdu.header.ack == 0) {
+      if (sock->state == SYN_RECEIVED) send_syn_ack(fd);
+      pthread_mutex_unlock(&sock->mutex);
+      return;
+   }
+
+   //? Si on recoit un SYN-ACK en réponse à notre SYN
+   if (pdu.header.syn == 1 && pdu.header.ack == 1) {
+      if (sock->state == SYN_SENT) {
+         LOG_INFO("SYN-ACK reçu pour le socket %d\n", fd);
+         //? Le serveur a pu retenir un taux de perte plus strict que celui proposé
+         acceptable_loss_rate[fd] = min_size(pdu.header.ack_num, acceptable_loss_rate[fd]);
+         LOG_INFO("[MIC-TCP] Taux de perte acceptable négocié : %d%%\n", acceptable_loss_rate[fd]);
+         send_handshake_ack(fd);
+         handshake_done(fd);
+      } else if (sock->state == ESTABLISHED) {
+         // Notre ACK a été perdu, le serveur a renvoyé son SYN-ACK
+         send_handshake_ack(fd);
+      }
+      pthread_mutex_unlock(&sock->mutex);
+      return;
+   }
+
+   //? Un ACK ou un premier PDU de données termine la connexion côté serveur
+   //? (le PDU de données prouve que le client a reçu le SYN-ACK)
+   if (sock->state == SYN_RECEIVED && pdu.header.fin == 0) {
+      LOG_DEBUG("[MIC-TCP] ACK reçu pour le SYN-ACK\n");
+      handshake_done(fd);
+   }
+
+   //! Réception d'un ACK par la source
+   if (sock->state == ESTABLISHED && pdu.header.ack == 1) {
+      handle_ack(fd, &pdu);
+   }
+
+   //! FORWARD : la source a résolu tous les PDU avant ack_num, on saute ceux qui manquent
+   if (sock->state == ESTABLISHED && pdu.header.fwd == 1) {
+      unsigned int before = expected_sequence[fd];
+      counters[fd].forwards_received++;
+      skip_to(fd, pdu.header.ack_num);
+      TRACE(TRACE_FORWARD_RECEIVED, fd, pdu.header.ack_num, before, expected_sequence[fd] - before);
+      if (expected_sequence[fd] != (int) before) notify_socket(fd);
+      send_data_ack(fd); //? Confirme le FORWARD (ou signale ce qui n'a pas pu être délivré)
+   }
+
+   //! Phase de transfert des données
+   if (sock->state == ESTABLISHED && pdu.header.ack == 0 && pdu.header.fin == 0 && pdu.header.fwd == 0) {
+      //? On conserve le PDU (même hors séquence) puis on délivre ce qui est dans l'ordre
+      //? (même pour un doublon : la file de l'application a pu se libérer depuis)
+      unsigned int delivered = expected_sequence[fd];
+      store_received_pdu(fd, &pdu);
+      TRACE(TRACE_DATA_RECEIVED, fd, pdu.header.seq_num, delivered, pdu.payload.size);
+      deliver_in_order(fd);
+
+      //? La source n'attend plus rien avant la base de sa fenêtre : les PDU
+      //? qui précèdent ont été abandonnés (perte acceptée), on les saute
+      skip_to(fd, pdu.header.ack_num);
+      if (expected_sequence[fd] != (int) delivered) notify_socket(fd);
+
+      //? Seul un PDU attendu, délivré sans en entraîner d'autres, peut attendre son ACK
+      ack_received_pdu(fd, pdu.header.seq_num == delivered && expected_sequence[fd] == (int) delivered + 1);
+   }
+   pthread_mutex_unlock(&sock->mutex);
+}
+
+/*
+ * Permet de réclamer la destruction d’un socket.
+ * Engendre la fermeture de la connexion suivant le modèle de TCP.
+ * Les PDU encore en vol sont attendus au plus MIC_TCP_LINGER µs, puis abandonnés
+ * Le descripteur est libéré et pourra être réattribué par mic_tcp_socket()
+ * Retourne 0 si tout se passe bien et -1 en cas d'erreur
+ */
+int mic_tcp_close (int socket) {
+   print_func_name(__FUNCTION__);
+   // Vérifie si le socket est valide
+   if (verif_socket(socket) == -1) return -1;
+
+   pthread_mutex_lock(&socket_list[socket].mutex);
+   //? Une connexion pas encore acceptée ne doit plus être rendue par mic_tcp_accept()
+   accept_queue_remove(socket);
+   //? Le PDU incomplet retenu par le regroupement part avant la fermeture
+   if (socket_list[socket].state == ESTABLISHED) {
+      flush_requested[socket] = 1;
+      try_transmit(socket);
+   }
+   //? Un ACK retardé part avant la fermeture
+   if (socket_list[socket].state == ESTABLISHED && pending_acks[socket] > 0) send_data_ack(socket);
+   //? Avant de fermer, on attend que tous les PDU soient acquittés ou abandonnés, au plus
+   //? linger_time µs : le puits a pu disparaître avant que les derniers ACK ne passent
+   struct timespec deadline;
+   clock_gettime(CLOCK_REALTIME, &deadline); // Horloge des conditions du socket
+   deadline.tv_sec += linger_time[socket] / 1000000;
+   deadline.tv_nsec += (linger_time[socket] % 1000000) * 1000L;
+   if (deadline.tv_nsec >= 1000000000L) {
+      deadline.tv_sec++;
+      deadline.tv_nsec -= 1000000000L;
+   }
+   while (socket_list[socket].state == ESTABLISHED && in_flight(socket) > 0) {
+      if (pthread_cond_timedwait(&socket_list[socket].cond, &socket_list[socket].mutex, &deadline) == ETIMEDOUT) {
+         LOG_INFO("[MIC-TCP] Socket %d: fermeture sans attendre %u PDU non acquittés\n", socket, in_flight(socket));
+         break;
+      }
+   }
+   TRACE(TRACE_CLOSED, socket, next_sequence[socket], expected_sequence[socket], socket_list[socket].state);
+   timer_cancel(&rto_timer[socket]);
+   timer_cancel(&handshake_timer[socket]);
+   timer_cancel(&coalesce_timer[socket]);
+   timer_cancel(&ack_timer[socket]);
+   demux_remove(socket);
+   listener_remove(socket_list[socket].local_addr.port, socket);
+   reset_send_window(socket);
+   reset_recv_window(socket);
+   app_buffer_close(socket); // Réveille les lectures en attente
+   socket_list[socket].state = CLOSED; // On change l'état du socket
+   pthread_cond_broadcast(&socket_list[socket].cond); // Réveille les threads encore bloqués sur le socket
+   notify_socket(socket);
+   pthread_mutex_unlock(&socket_list[socket].mutex);
+
+   pthread_mutex_lock(&socket_list_lock);
+   socket_list[socket].in_use = 0;
+   pthread_mutex_unlock(&socket_list_lock);
+   return 0;
+}
+
+//!     ______________________________
+//!    |_PARTIE_OPTIONS_STATISTIQUES_|
+
+/*
+ * Modifie une option d'un socket (voir mic_tcp_option dans mictcp.h)
+ * Retourne 0 si succès, -1 si le socket, l'option ou la valeur est invalide
+ */
+int mic_tcp_set_option(int socket, mic_tcp_option option, long value) {
+   print_func_name(__FUNCTION__);
+   if (verif_socket(socket) == -1) return -1;
+
+   rtt_estimator_t *est = &rtt_estimator[socket];
+   int result = -1;
+   pthread_mutex_lock(&socket_list[socket].mutex);
+   switch (option) {
+      case MIC_TCP_RTO_MIN:
+         if (value <= 0 || (unsigned long) value > est->max_rto) break;
+         est->min_rto = value;
+         est->rto = clamp_rto(est, est->rto);
+         result = 0;
+         break;
+      case MIC_TCP_RTO_MAX:
+         if (value <= 0 || (unsigned long) value < est->min_rto) break;
+         est->max_rto = value;
+         est->rto = clamp_rto(est, est->rto);
+         result = 0;
+         break;
+      case MIC_TCP_CONGESTION:
+         // Changer d'algorithme en cours de connexion repart de la fenêtre initiale
+         result = init_congestion(socket, (mic_tcp_cc_algo) value);
+         // La nouvelle fenêtre peut autoriser l'envoi de PDU en attente
+         if (result == 0 && socket_list[socket].state == ESTABLISHED) try_transmit(socket);
+         break;
+      case MIC_TCP_NONBLOCK:
+         nonblocking[socket] = value != 0;
+         result = 0;
+         break;
+      case MIC_TCP_STREAM:
+         stream_mode[socket] = value != 0;
+         result = 0;
+         break;
+      case MIC_TCP_COALESCE:
+         if (value < 0) break;
+         coalesce_delay[socket] = value;
+         //? Sans regroupement, le PDU retenu n'a plus de raison d'attendre
+         flush_requested[socket] = 1;
+         if (socket_list[socket].state == ESTABLISHED) try_transmit(socket);
+         result = 0;
+         break;
+      case MIC_TCP_CORK:
+         corked[socket] = value != 0;
+         if (!corked[socket]) { // Retirer le bouchon envoie ce qui attendait
+            flush_requested[socket] = 1;
+            if (socket_list[socket].state == ESTABLISHED) try_transmit(socket);
+         }
+         result = 0;
+         break;
+      case MIC_TCP_ACK_EVERY:
+         if (value < 1) break;
+         ack_every[socket] = value;
+         //? Un ACK retardé qui atteint déjà le nouveau seuil part tout de suite
+         if (socket_list[socket].state == ESTABLISHED && pending_acks[socket] >= ack_every[socket]) send_data_ack(socket);
+         result = 0;
+         break;
+      case MIC_TCP_ACK_DELAY:
+         if (value <= 0) break;
+         ack_delay[socket] = value;
+         result = 0;
+         break;
+      case MIC_TCP_LOSS_TOLERANCE:
+         //? Négocié à l'établissement : le taux n'est plus modifiable sur une connexion
+         if (value < 0 || value > 100 || (socket_list[socket].state != IDLE && socket_list[socket].state != CLOSED)) break;
+         acceptable_loss_rate[socket] = value;
+         result = 0;
+         break;
+      case MIC_TCP_LINGER:
+         if (value < 0) break;
+         linger_time[socket] = value;
+         result = 0;
+         break;
+      case MIC_TCP_DEADLINE:
+         if (value < 0) break;
+         message_lifetime[socket] = value; // S'applique aux messages envoyés ensuite
+         result = 0;
+         break;
+      case MIC_TCP_LOSS_WINDOW:
+         if (value < 1 || value > LOSS_WINDOW_MAX) break;
+         init_a_sliding_window(socket, value, loss_window[socket].decay); // Repart d'une fenêtre vide
+         result = 0;
+         break;
+      case MIC_TCP_LOSS_DECAY:
+         if (value < 0) break;
+         init_a_sliding_window(socket, loss_window[socket].size, value);
+         result = 0;
+         break;
+      default:
+         break;
+   }
+   pthread_mutex_unlock(&socket_list[socket].mutex);
+   return result;
+}
+
+/*
+ * Lit la valeur courante d'une option d'un socket
+ * Retourne 0 si succès, -1 si le socket ou l'option est invalide
+ */
+int mic_tcp_get_option(int socket, mic_tcp_option option, long* value) {
+   if (verif_socket(socket) == -1 || value == NULL) return -1;
+
+   int result = 0;
+   pthread_mutex_lock(&socket_list[socket].mutex);
+   switch (option) {
+      case MIC_TCP_RTO_MIN: *value = rtt_estimator[socket].min_rto; break;
+      case MIC_TCP_RTO_MAX: *value = rtt_estimator[socket].max_rto; break;
+      case MIC_TCP_CONGESTION: *value = congestion[socket].algo; break;
+      case MIC_TCP_NONBLOCK: *value = nonblocking[socket]; break;
+      case MIC_TCP_STREAM: *value = stream_mode[socket]; break;
+      case MIC_TCP_COALESCE: *value = coalesce_delay[socket]; break;
+      case MIC_TCP_CORK: *value = corked[socket]; break;
+      case MIC_TCP_ACK_EVERY: *value = ack_every[socket]; break;
+      case MIC_TCP_ACK_DELAY: *value = ack_delay[socket]; break;
+      case MIC_TCP_LOSS_TOLERANCE: *value = acceptable_loss_rate[socket]; break;
+      case MIC_TCP_LOSS_WINDOW: *value = loss_window[socket].size; break;
+      case MIC_TCP_LOSS_DECAY: *value = loss_window[socket].decay; break;
+      case MIC_TCP_LINGER: *value = linger_time[socket]; break;
+      case MIC_TCP_DEADLINE: *value = message_lifetime[socket]; break;
+      default: result = -1;
+   }
+   pthread_mutex_unlock(&socket_list[socket].mutex);
+   return result;
+}
+
+/*
+ * Envoie sans attendre le PDU incomplet retenu par MIC_TCP_COALESCE ou MIC_TCP_CORK
+ * (le bouchon reste en place pour les envois suivants)
+ * Retourne 0 si succès, -1 si le socket est invalide
+ */
+int mic_tcp_flush(int socket) {
+   print_func_name(__FUNCTION__);
+   if (verif_socket(socket) == -1) return -1;
+
+   pthread_mutex_lock(&socket_list[socket].mutex);
+   flush_requested[socket] = 1;
+   if (socket_list[socket].state == ESTABLISHED) try_transmit(socket);
+   pthread_mutex_unlock(&socket_list[socket].mutex);
+   return 0;
+}
+
+/*
+ * Evénements MIC_TCP_POLL* prêts sur le socket (mutex du socket verrouillé)
+ */
+short socket_events(int socket) {
+   short events = 0;
+   mic_tcp_sock *sock = &socket_list[socket];
+   if (cq_head[socket] != cq_tail[socket]) events |= MIC_TCP_POLLCQ;
+   if (sock->state == IDLE && accept_head[socket] != -1) events |= MIC_TCP_POLLIN;
+   if (sock->state == ESTABLISHED) {
+      if (app_buffer_readable(socket)) events |= MIC_TCP_POLLIN;
+      if (in_flight(socket) < SEND_WINDOW_SIZE) events |= MIC_TCP_POLLOUT;
+   }
+   return events;
+}
+
+/*
+ * Attend qu'au moins un des sockets de fds soit prêt pour les événements demandés
+ * (MIC_TCP_POLLIN, MIC_TCP_POLLOUT), pendant au plus timeout ms (-1 : sans limite,
+ * 0 : sans attendre). Un seul thread suffit ainsi pour servir de nombreux sockets
+ * Retourne le nombre de sockets dont revents est non nul, 0 si le délai expire, -1 si erreur
+ */
+int mic_tcp_poll(mic_tcp_pollfd* fds, int nfds, int timeout) {
+   if (fds == NULL || nfds < 0 || nfds > MAX_SOCKETS) return -1;
+   struct pollfd pfds[nfds > 0 ? nfds : 1];
+   unsigned long deadline = get_now_time_msec() + (timeout > 0 ? timeout : 0);
+
+   while (1) {
+      int ready = 0;
+      for (int i = 0; i < nfds; i++) {
+         int fd = fds[i].fd;
+         fds[i].revents = 0;
+         pfds[i].fd = -1; // Ignoré par poll()
+         pfds[i].events = POLLIN;
+         if (fd < 0 || fd >= MAX_SOCKETS || !socket_list[fd].in_use) {
+            fds[i].revents = MIC_TCP_POLLNVAL;
+            ready++;
+            continue;
+         }
+         pthread_mutex_lock(&socket_list[fd].mutex);
+         //? L'eventfd est vidé avant de lire l'état : un changement ultérieur le signalera
+         pfds[i].fd = watch_socket(fd);
+         if (pfds[i].fd != -1) {
+            uint64_t count;
+            if (read(pfds[i].fd, &count, sizeof(count)) == -1) count = 0;
+         }
+         fds[i].revents = socket_events(fd) & fds[i].events;
+         pthread_mutex_unlock(&socket_list[fd].mutex);
+         if (fds[i].revents != 0) ready++;
+      }
+      if (ready > 0 || timeout == 0) return ready;
+
+      int wait = -1;
+      if (timeout > 0) {
+         unsigned long now = get_now_time_msec();
+         if (now >= deadline) return 0;
+         wait = deadline - now;
+      }
+      if (poll(pfds, nfds, wait) == -1 && errno != EINTR) return -1;
+   }
+}
+
+/*
+ * Retourne un eventfd, à surveiller dans la boucle epoll/poll de l'application,
+ * qui devient lisible quand l'état du socket change ; mic_tcp_poll() (par exemple
+ * avec un délai nul) le vide et indique les événements prêts. -1 si erreur
+ */
+int mic_tcp_get_eventfd(int socket) {
+   if (verif_socket(socket) == -1) return -1;
+   pthread_mutex_lock(&socket_list[socket].mutex);
+   int efd = watch_socket(socket);
+   pthread_mutex_unlock(&socket_list[socket].mutex);
+   return efd;
+}
+
+/*
+ * Mise en file d'un envoi asynchrone, d'échéance maintenant + lifetime µs
+ * (0 : sans échéance, -1 : durée de vie de l'option MIC_TCP_DEADLINE)
+ */
+int send_async(int socket, char* mesg, int mesg_size, void* user_data, long lifetime) {
+   if (verif_socket(socket) == -1) {
+      errno = EBADF;
+      return -1;
+   }
+   if (mesg_size < 0) {
+      errno = EINVAL;
+      return -1;
+   }
+   if (mesg_size > MAX_PAYLOAD_SIZE) {
+      errno = EMSGSIZE;
+      return -1;
+   }
+
+   pthread_mutex_lock(&socket_list[socket].mutex);
+   int result = -1;
+   unsigned long deadline = lifetime < 0 ? message_deadline(socket) : lifetime > 0 ? get_now_time_usec() + lifetime : 0;
+   if (socket_list[socket].state != ESTABLISHED) {
+      errno = ENOTCONN;
+   } else if (in_flight(socket) >= SEND_WINDOW_SIZE || !async_room(socket)) {
+      errno = EAGAIN;
+   } else if (queue_pdu(socket, mesg, mesg_size, 1, user_data, deadline) == 0) {
+      async_pending[socket]++;
+      result = mesg_size;
+   } else {
+      errno = ENOBUFS; // Réserve de tampons épuisée
+   }
+   pthread_mutex_unlock(&socket_list[socket].mutex);
+   return result;
+}
+
+/*
+ * Place une donnée dans la fenêtre d'émission sans jamais attendre : une complétion
+ * MIC_TCP_SEND_ACKED ou MIC_TCP_SEND_ABANDONED (perte acceptée) portant user_data
+ * est postée quand son sort est connu. mesg peut être réutilisé dès le retour
+ * Retourne la taille des données, -1 si erreur (errno à EAGAIN si la fenêtre
+ * d'émission ou la file des complétions est pleine, EBADF si le socket est invalide,
+ * EMSGSIZE si la donnée dépasse MAX_PAYLOAD_SIZE, ENOTCONN ou ENOBUFS sinon)
+ */
+int mic_tcp_send_async(int socket, char* mesg, int mesg_size, void* user_data) {
+   return send_async(socket, mesg, mesg_size, user_data, -1);
+}
+
+/*
+ * Comme mic_tcp_send_async(), avec une durée de vie en µs propre à cette donnée
+ * (fiabilité par échéance, voir MIC_TCP_DEADLINE ; 0 : sans échéance) au lieu de
+ * celle de l'option : l'échéance est fixée dans le même appel que la mise en file
+ */
+int mic_tcp_send_async_deadline(int socket, char* mesg, int mesg_size, void* user_data, long lifetime) {
+   if (lifetime < 0) {
+      errno = EINVAL;
+      return -1;
+   }
+   return send_async(socket, mesg, mesg_size, user_data, lifetime);
+}
+
+/*
+ * Fournit un tampon que le thread de réception remplira avec la prochaine donnée
+ * (dans l'ordre, après celles déjà en file) ; une complétion MIC_TCP_RECV_DONE portant
+ * user_data est postée alors. mesg doit rester valide jusqu'à la complétion
+ * Un socket ne doit pas être lu en même temps par mic_tcp_recv()
+ * Retourne 0, -1 si erreur (errno à EAGAIN si la file des complétions est pleine,
+ * EBADF si le socket est invalide, EINVAL si le tampon l'est, ENOTCONN s'il est fermé)
+ */
+int mic_tcp_recv_async(int socket, char* mesg, int max_mesg_size, void* user_data) {
+   if (verif_socket(socket) == -1) {
+      errno = EBADF;
+      return -1;
+   }
+   if (mesg == NULL || max_mesg_size < 0) {
+      errno = EINVAL;
+      return -1;
+   }
+
+   pthread_mutex_lock(&socket_list[socket].mutex);
+   if (!async_room(socket)) {
+      pthread_mutex_unlock(&socket_list[socket].mutex);
+      errno = EAGAIN;
+      return -1;
+   }
+   async_pending[socket]++;
+
+   //? Une donnée déjà en file termine l'opération tout de suite
+   mic_tcp_payload payload = { mesg, max_mesg_size };
+   int size = app_buffer_get(socket, payload, 0);
+   if (size >= 0) {
+      post_completion(socket, MIC_TCP_RECV_DONE, size, user_data);
+   } else if (errno == EAGAIN) {
+      async_recv_t *posted = &posted_recv[socket][posted_tail[socket]++ % MIC_TCP_CQ_SIZE];
+      posted->data = mesg;
+      posted->size = max_mesg_size;
+      posted->user_data = user_data;
+      // Des PDU retenus faute de place dans la file peuvent maintenant être délivrés
+      if (socket_list[socket].state == ESTABLISHED) deliver_in_order(socket);
+   } else {
+      async_pending[socket]--; // Socket fermé
+      pthread_mutex_unlock(&socket_list[socket].mutex);
+      errno = ENOTCONN;
+      return -1;
+   }
+   pthread_mutex_unlock(&socket_list[socket].mutex);
+   return 0;
+}
+
+/*
+ * Copie dans completions au plus max complétions du socket, en attendant au plus
+ * timeout ms qu'il y en ait une (-1 : sans limite, 0 : sans attendre)
+ * Retourne le nombre de complétions copiées, -1 si erreur
+ */
+int mic_tcp_get_completions(int socket, mic_tcp_completion* out, int max, int timeout) {
+   if (verif_socket(socket) == -1 || out == NULL || max <= 0) return -1;
+
+   struct timespec deadline;
+   clock_gettime(CLOCK_REALTIME, &deadline); // Horloge des conditions du socket
+   deadline.tv_sec += timeout / 1000;
+   deadline.tv_nsec += (timeout % 1000) * 1000000L;
+   if (deadline.tv_nsec >= 1000000000L) {
+      deadline.tv_sec++;
+      deadline.tv_nsec -= 1000000000L;
+   }
+
+   pthread_mutex_lock(&socket_list[socket].mutex);
+   while (cq_head[socket] == cq_tail[socket] && timeout != 0 && socket_list[socket].in_use && async_pending[socket] > 0) {
+      if (timeout < 0) pthread_cond_wait(&socket_list[socket].cond, &socket_list[socket].mutex);
+      else if (pthread_cond_timedwait(&socket_list[socket].cond, &socket_list[socket].mutex, &deadline) == ETIMEDOUT) break;
+   }
+   int count = 0;
+   while (count < max && cq_head[socket] != cq_tail[socket]) {
+      out[count++] = completions[socket][cq_head[socket]++ % MIC_TCP_CQ_SIZE];
+   }
+   pthread_mutex_unlock(&socket_list[socket].mutex);
+   return count;
+}
+
+/*
+ * Copie les statistiques du pool de tampons de paquets dans stats
+ * Retourne 0 si succès, -1 si stats est invalide
+ */
+int mic_tcp_get_pool_stats(mic_tcp_pool_stats* stats) {
+   if (stats == NULL) return -1;
+   pool_get_stats(stats);
+   return 0;
+}
+
+/*
+ * Fixe le nombre maximum de datagrammes lus par appel système par le
+ * thread de réception (1 : un datagramme par appel)
+ * Retourne 0 si succès, -1 si la taille est hors de [1, MIC_TCP_BATCH_MAX]
+ */
+int mic_tcp_set_batch_size(unsigned int size) {
+   return IP_set_batch_size(size);
+}
+
+/*
+ * Active (enable != 0) ou désactive la segmentation UDP par le noyau :
+ * GSO à l'envoi des PDU regroupés, GRO à la réception (Linux >= 5.0)
+ * A appeler après mic_tcp_socket(), sur les deux hôtes
+ * Retourne 0 si succès, -1 si le noyau ne le permet pas
+ */
+int mic_tcp_set_offload(int enable) {
+   return IP_set_offload(enable);
+}
+
+/*
+ * Fixe le nombre de threads de réception d'un serveur : chacun lit sa propre
+ * socket UDP (SO_REUSEPORT) sur son propre coeur, et tous les PDU d'une
+ * connexion sont traités par le même thread
+ * A appeler avant le premier mic_tcp_socket(SERVER)
+ * Retourne 0 si succès, -1 si count est hors de [1, MIC_TCP_MAX_WORKERS] ou trop tard
+ */
+int mic_tcp_set_workers(unsigned int count) {
+   return IP_set_workers(count);
+}
+
+/*
+ * Copie les statistiques des entrées/sorties par lots dans stats
+ * Retourne 0 si succès, -1 si stats est invalide
+ */
+int mic_tcp_get_io_stats(mic_tcp_io_stats* stats) {
+   if (stats == NULL) return -1;
+   IP_get_io_stats(stats);
+   return 0;
+}
+
+/*
+ * Remplit stats avec l'état courant d'un socket (mutex du socket verrouillé)
+ */
+void fill_stats(int socket, mic_tcp_stats* stats) {
+   rtt_estimator_t *est = &rtt_estimator[socket];
+   socket_counters_t *c = &counters[socket];
+   memset(stats, 0, sizeof(mic_tcp_stats));
+   stats->srtt = est->srtt;
+   stats->rttvar = est->rttvar;
+   stats->rto = est->rto;
+   stats->last_rtt = est->last_rtt;
+   stats->min_rtt = est->min_rtt;
+   stats->rtt_samples = est->samples;
+   stats->rto_expirations = est->expirations;
+   stats->backoffs = est->backoffs;
+   stats->cwnd = congestion[socket].state.cwnd;
+   stats->ssthresh = congestion[socket].state.ssthresh;
+   stats->congestion_events = congestion[socket].events;
+   stats->coalesced_writes = c->coalesced_writes;
+   stats->data_received = c->segments_received;
+   stats->acks_sent = c->acks_sent;
+   stats->delayed_acks = c->delayed_acks;
+   stats->bytes_sent = c->bytes_sent;
+   stats->segments_sent = c->segments_sent;
+   stats->retransmissions = c->retransmissions;
+   stats->losses_accepted = c->losses_accepted;
+   stats->deadline_drops = c->deadline_drops;
+   stats->forwards_sent = c->forwards_sent;
+   stats->forwards_received = c->forwards_received;
+   stats->loss_rate = calculate_current_loss_rate(socket);
+   stats->loss_tolerance = acceptable_loss_rate[socket];
+   stats->bytes_received = c->bytes_received;
+   stats->segments_skipped = c->segments_skipped;
+   stats->send_queue = in_flight(socket);
+   for (int i = 0; i < RECV_WINDOW_SIZE; i++) {
+      if (recv_window[socket].slots[i].present) stats->reorder_queue++;
+   }
+   stats->recv_queue = app_buffer_depth(socket);
+}
+
+/*
+ * Copie les statistiques courantes d'un socket dans stats
+ * Retourne 0 si succès, -1 si le socket est invalide
+ */
+int mic_tcp_get_stats(int socket, mic_tcp_stats* stats) {
+   if (verif_socket(socket) == -1 || stats == NULL) return -1;
+
+   pthread_mutex_lock(&socket_list[socket].mutex);
+   fill_stats(socket, stats);
+   pthread_mutex_unlock(&socket_list[socket].mutex);
+   return 0;
+}
+
+/*
+ * Recopie les statistiques de tous les sockets dans le segment partagé
+ * (appelée par le thread protocole, toutes les stats_segment->period µs)
+ */
+void export_timer_expired(void *arg) {
+   mic_tcp_stats_segment *segment = stats_segment;
+   pthread_mutex_lock(&socket_list_lock);
+   int used = last_used_socket;
+   pthread_mutex_unlock(&socket_list_lock);
+
+   for (int socket = 0; socket < used; socket++) {
+      mic_tcp_stats_entry *entry = &segment->sockets[socket];
+      mic_tcp_stats stats;
+      pthread_mutex_lock(&socket_list[socket].mutex);
+      int in_use = socket_list[socket].in_use;
+      if (in_use) fill_stats(socket, &stats);
+      //? Seqlock : un compteur impair signale au lecteur une entrée en cours d'écriture
+      __atomic_store_n(&entry->sequence, entry->sequence + 1, __ATOMIC_RELAXED);
+      __atomic_thread_fence(__ATOMIC_RELEASE);
+      entry->in_use = in_use;
+      entry->state = socket_list[socket].state;
+      entry->local_port = socket_list[socket].local_addr.port;
+      entry->remote_port = socket_list[socket].remote_addr.port;
+      if (in_use) entry->stats = stats;
+      __atomic_store_n(&entry->sequence, entry->sequence + 1, __ATOMIC_RELEASE);
+      pthread_mutex_unlock(&socket_list[socket].mutex);
+   }
+   __atomic_add_fetch(&segment->updates, 1, __ATOMIC_RELEASE);
+   timer_arm(&export_timer, get_now_time_usec() + segment->period);
+}
+
+/*
+ * Publie les statistiques de tous les sockets dans le segment de mémoire partagée
+ * name (shm_open(), par exemple "/mictcp"), mis à jour toutes les period µs
+ * (MIC_TCP_STATS_PERIOD si 0) par le thread protocole : le chemin des données
+ * n'écrit rien de plus, un lecteur externe (build/stats_dump) n'a besoin d'aucun
+ * appel à la bibliothèque. Un seul segment par processus
+ * Retourne 0 si succès, -1 en cas d'erreur
+ */
+int mic_tcp_stats_export(const char* name, unsigned long period) {
+   if (name == NULL) return -1;
+   pthread_mutex_lock(&stats_lock);
+   if (stats_segment != NULL) {
+      pthread_mutex_unlock(&stats_lock);
+      return -1;
+   }
+   int fd = shm_open(name, O_RDWR | O_CREAT | O_TRUNC, 0644);
+   if (fd == -1 || ftruncate(fd, sizeof(mic_tcp_stats_segment)) == -1) {
+      LOG_ERROR("[MIC-TCP] Erreur: impossible de créer le segment de statistiques %s\n", name);
+      if (fd != -1) close(fd);
+      pthread_mutex_unlock(&stats_lock);
+      return -1;
+   }
+   mic_tcp_stats_segment *segment = mmap(NULL, sizeof(mic_tcp_stats_segment), PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+   close(fd);
+   if (segment == MAP_FAILED) {
+      pthread_mutex_unlock(&stats_lock);
+      return -1;
+   }
+   segment->magic = MIC_TCP_STATS_MAGIC;
+   segment->version = MIC_TCP_STATS_VERSION;
+   segment->max_sockets = MAX_SOCKETS;
+   segment->pid = getpid();
+   segment->period = period > 0 ? period : MIC_TCP_STATS_PERIOD;
+   stats_segment = segment;
+   pthread_mutex_unlock(&stats_lock);
+
+   LOG_INFO("[MIC-TCP] Statistiques publiées dans le segment %s\n", name);
+   timer_init(&export_timer, export_timer_expired, NULL);
+   timer_arm(&export_timer, get_now_time_usec() + segment->period);
+   return 0;
+}
+
+
+/*
+ * Active la trace binaire des événements du protocole dans le fichier path
+ * (voir mictcp_trace.h, décodée par build/trace_decode)
+ * Retourne 0 si succès, -1 en cas d'erreur
+ */
+int mic_tcp_trace_open(const char* path) {
+   if (path == NULL) return -1;
+   return trace_open(path);
+}
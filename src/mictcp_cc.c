@@ -0,0 +1,119 @@
+#include <mictcp_cc.h>
+
+//!     _________________
+//!    |_PARTIE_NEWRENO_| (RFC 5681 / RFC 6582)
+
+/*
+ * Fenêtre initiale, slow start jusqu'à la première perte
+ */
+static void reno_init(cc_state_t* cc) {
+   memset(cc, 0, sizeof(cc_state_t));
+   cc->cwnd = CC_INITIAL_WINDOW;
+   cc->ssthresh = SEND_WINDOW_SIZE;
+}
+
+/*
+ * Slow start (+1 PDU par PDU acquitté) puis évitement de congestion (+1 PDU par RTT)
+ */
+static void reno_on_ack(cc_state_t* cc, unsigned int acked, unsigned long rtt, unsigned long now) {
+   if (cc->in_recovery) return; // La fenêtre reste à ssthresh pendant la récupération
+   if (cc->cwnd < cc->ssthresh) {
+      cc->cwnd += acked;
+   } else {
+      cc->cwnd += (double) acked / cc->cwnd;
+   }
+   if (cc->cwnd > SEND_WINDOW_SIZE) cc->cwnd = SEND_WINDOW_SIZE;
+}
+
+/*
+ * Réduction multiplicative de moitié
+ */
+static void reno_on_loss(cc_state_t* cc, unsigned long now) {
+   cc->ssthresh = fmax(cc->cwnd / 2, CC_MIN_WINDOW);
+   cc->cwnd = cc->ssthresh;
+}
+
+/*
+ * Retour en slow start avec une fenêtre d'un PDU
+ */
+static void reno_on_timeout(cc_state_t* cc, unsigned long now) {
+   cc->ssthresh = fmax(cc->cwnd / 2, CC_MIN_WINDOW);
+   cc->cwnd = 1;
+}
+
+const cc_ops_t cc_reno = { "reno", reno_init, reno_on_ack, reno_on_loss, reno_on_timeout };
+
+//!     _______________
+//!    |_PARTIE_CUBIC_| (RFC 8312)
+
+/*
+ * CUBIC démarre comme Reno (slow start), sans époque de croissance en cours
+ */
+static void cubic_init(cc_state_t* cc) {
+   reno_init(cc);
+}
+
+/*
+ * En évitement de congestion, la fenêtre suit W(t) = C (t - K)^3 + W_max
+ * sans descendre sous l'estimation de Reno (région "TCP friendly")
+ */
+static void cubic_on_ack(cc_state_t* cc, unsigned int acked, unsigned long rtt, unsigned long now) {
+   if (cc->in_recovery) return;
+   if (cc->cwnd < cc->ssthresh) {
+      cc->cwnd += acked;
+   } else {
+      if (cc->epoch_start == 0) {
+         // Nouvelle époque : on repart de la fenêtre courante
+         cc->epoch_start = now;
+         if (cc->w_max < cc->cwnd) cc->w_max = cc->cwnd;
+         cc->k = cbrt(cc->w_max * (1 - CUBIC_BETA) / CUBIC_C);
+         cc->w_est = cc->cwnd;
+      }
+      double t = (now - cc->epoch_start + rtt) / 1000000.0; // Fenêtre visée un RTT plus tard
+      double target = CUBIC_C * pow(t - cc->k, 3) + cc->w_max;
+      // Reno : +3(1-beta)/(1+beta) PDU par RTT pour le même beta
+      cc->w_est += 3 * (1 - CUBIC_BETA) / (1 + CUBIC_BETA) * acked / cc->cwnd;
+      if (target < cc->w_est) target = cc->w_est;
+      if (target > cc->cwnd) {
+         cc->cwnd += (target - cc->cwnd) / cc->cwnd * acked;
+      } else {
+         cc->cwnd += 0.01 * acked / cc->cwnd; // Plateau autour de w_max
+      }
+   }
+   if (cc->cwnd > SEND_WINDOW_SIZE) cc->cwnd = SEND_WINDOW_SIZE;
+}
+
+/*
+ * Réduction de (1 - beta), avec convergence rapide si la fenêtre n'a pas retrouvé w_max
+ */
+static void cubic_on_loss(cc_state_t* cc, unsigned long now) {
+   cc->epoch_start = 0;
+   if (cc->cwnd < cc->w_max) {
+      cc->w_max = cc->cwnd * (1 + CUBIC_BETA) / 2;
+   } else {
+      cc->w_max = cc->cwnd;
+   }
+   cc->ssthresh = fmax(cc->cwnd * CUBIC_BETA, CC_MIN_WINDOW);
+   cc->cwnd = cc->ssthresh;
+}
+
+/*
+ * Après un timeout, CUBIC repart en slow start comme Reno
+ */
+static void cubic_on_timeout(cc_state_t* cc, unsigned long now) {
+   cubic_on_loss(cc, now);
+   cc->cwnd = 1;
+}
+
+const cc_ops_t cc_cubic = { "cubic", cubic_init, cubic_on_ack, cubic_on_loss, cubic_on_timeout };
+
+/*
+ * Retourne les fonctions de l'algorithme demandé, NULL s'il est inconnu
+ */
+const cc_ops_t* cc_get_ops(mic_tcp_cc_algo algo) {
+   switch (algo) {
+      case MIC_TCP_CC_RENO: return &cc_reno;
+      case MIC_TCP_CC_CUBIC: return &cc_cubic;
+      default: return NULL;
+   }
+}
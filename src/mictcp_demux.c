@@ -0,0 +1,122 @@
+#include <mictcp_demux.h>
+
+typedef struct {
+   demux_key_t key;               // Quadruplet de la connexion
+   int in_table;                  // 1 si le descripteur est dans la table
+   int next;                      // Descripteur suivant dans l'alvéole (-1 en fin de chaîne)
+} demux_entry_t;
+
+int buckets[DEMUX_BUCKETS]; // Premier descripteur de chaque alvéole, plus 1 (0 : alvéole vide)
+demux_entry_t entries[MAX_SOCKETS]; // Entrée de chaque descripteur
+int listeners[65536]; // Descripteur en écoute sur chaque port local, plus 1 (0 : aucun)
+pthread_rwlock_t demux_lock = PTHREAD_RWLOCK_INITIALIZER; // Lectures concurrentes par le thread de réception
+
+/*
+ * Alvéole d'une clé (mélange multiplicatif des trois champs)
+ */
+static unsigned int demux_hash(demux_key_t key) {
+   uint32_t h = (key.remote_ip ^ key.remote_udp_port) * 0x9E3779B1u;
+   h ^= ((uint32_t) key.local_port << 16 | key.remote_port) * 0x85EBCA6Bu;
+   h ^= h >> 15;
+   return h & (DEMUX_BUCKETS - 1);
+}
+
+static int same_key(demux_key_t a, demux_key_t b) {
+   return a.local_port == b.local_port && a.remote_ip == b.remote_ip
+      && a.remote_udp_port == b.remote_udp_port && a.remote_port == b.remote_port;
+}
+
+/*
+ * Cherche une connexion (le verrou de la table doit être pris)
+ */
+static int find(demux_key_t key) {
+   for (int fd = buckets[demux_hash(key)] - 1; fd != -1; fd = entries[fd].next) {
+      if (same_key(entries[fd].key, key)) return fd;
+   }
+   return -1;
+}
+
+/*
+ * Ajoute la connexion du socket fd
+ * Retourne 0 si succès, -1 si le quadruplet est déjà utilisé ou fd déjà présent
+ */
+int demux_insert(demux_key_t key, int fd) {
+   if (fd < 0 || fd >= MAX_SOCKETS) return -1;
+   pthread_rwlock_wrlock(&demux_lock);
+   if (entries[fd].in_table || find(key) != -1) {
+      pthread_rwlock_unlock(&demux_lock);
+      return -1;
+   }
+   unsigned int bucket = demux_hash(key);
+   entries[fd].key = key;
+   entries[fd].in_table = 1;
+   entries[fd].next = buckets[bucket] - 1;
+   buckets[bucket] = fd + 1;
+   pthread_rwlock_unlock(&demux_lock);
+   return 0;
+}
+
+/*
+ * Retire la connexion du socket fd (sans effet si elle n'est pas dans la table)
+ */
+void demux_remove(int fd) {
+   if (fd < 0 || fd >= MAX_SOCKETS) return;
+   pthread_rwlock_wrlock(&demux_lock);
+   if (entries[fd].in_table) {
+      int* link = &buckets[demux_hash(entries[fd].key)];
+      // Le chaînage stocke fd + 1 en tête d'alvéole et fd dans les entrées
+      if (*link == fd + 1) {
+         *link = entries[fd].next + 1;
+      } else {
+         int prev = *link - 1;
+         while (entries[prev].next != fd) prev = entries[prev].next;
+         entries[prev].next = entries[fd].next;
+      }
+      entries[fd].in_table = 0;
+   }
+   pthread_rwlock_unlock(&demux_lock);
+}
+
+/*
+ * Retourne le descripteur de la connexion key, -1 si aucune
+ */
+int demux_lookup(demux_key_t key) {
+   pthread_rwlock_rdlock(&demux_lock);
+   int fd = find(key);
+   pthread_rwlock_unlock(&demux_lock);
+   return fd;
+}
+
+/*
+ * Enregistre fd comme socket en écoute sur port
+ * Retourne 0 si succès, -1 si un autre socket écoute déjà sur ce port
+ */
+int listener_insert(unsigned short port, int fd) {
+   pthread_rwlock_wrlock(&demux_lock);
+   int result = -1;
+   if (listeners[port] == 0 || listeners[port] == fd + 1) {
+      listeners[port] = fd + 1;
+      result = 0;
+   }
+   pthread_rwlock_unlock(&demux_lock);
+   return result;
+}
+
+/*
+ * Retire fd des sockets en écoute (sans effet s'il n'écoute pas sur port)
+ */
+void listener_remove(unsigned short port, int fd) {
+   pthread_rwlock_wrlock(&demux_lock);
+   if (listeners[port] == fd + 1) listeners[port] = 0;
+   pthread_rwlock_unlock(&demux_lock);
+}
+
+/*
+ * Retourne le descripteur en écoute sur port, -1 si aucun
+ */
+int listener_lookup(unsigned short port) {
+   pthread_rwlock_rdlock(&demux_lock);
+   int fd = listeners[port] - 1;
+   pthread_rwlock_unlock(&demux_lock);
+   return fd;
+}
@@ -0,0 +1,163 @@
+#include <mictcp_timer.h>
+#include <time.h>
+
+#define FIRE_BATCH 64 // Nombre de timers échus collectés à chaque passage
+
+mic_tcp_timer* wheel[TIMER_WHEEL_SLOTS]; // Listes de timers, indexées par tick % TIMER_WHEEL_SLOTS
+unsigned long current_tick = 0; // Dernier tick traité (0 tant que la roue n'a pas tourné)
+pthread_mutex_t wheel_lock = PTHREAD_MUTEX_INITIALIZER;
+pthread_cond_t wheel_cond; // Réveille le thread protocole quand un timer plus proche est armé
+pthread_once_t wheel_once = PTHREAD_ONCE_INIT;
+unsigned long wake_tick = 0; // Tick auquel le thread protocole doit se réveiller (0 : aucun)
+int wheel_waiting = 0; // 1 si le thread protocole est bloqué dans timer_wheel_wait()
+
+/*
+ * Initialise la condition de la roue sur l'horloge monotone de get_now_time_usec()
+ */
+static void wheel_init(void) {
+   pthread_condattr_t attr;
+   pthread_condattr_init(&attr);
+   pthread_condattr_setclock(&attr, CLOCK_MONOTONIC);
+   pthread_cond_init(&wheel_cond, &attr);
+   pthread_condattr_destroy(&attr);
+}
+
+/*
+ * Retire un timer de son emplacement (le verrou de la roue doit être pris)
+ */
+static void unlink_timer(mic_tcp_timer* timer) {
+   if (timer->prev != NULL) timer->prev->next = timer->next;
+   else wheel[timer->tick % TIMER_WHEEL_SLOTS] = timer->next;
+   if (timer->next != NULL) timer->next->prev = timer->prev;
+   timer->next = timer->prev = NULL;
+   timer->armed = 0;
+}
+
+/*
+ * Prépare un timer désarmé
+ */
+void timer_init(mic_tcp_timer* timer, void (*callback)(void*), void* arg) {
+   pthread_mutex_lock(&wheel_lock);
+   if (timer->armed) unlink_timer(timer);
+   timer->callback = callback;
+   timer->arg = arg;
+   timer->generation++;
+   pthread_mutex_unlock(&wheel_lock);
+}
+
+/*
+ * Arme (ou réarme) un timer pour la date expires en µs
+ * Le timer n'est jamais déclenché avant expires, au plus un tick après
+ */
+void timer_arm(mic_tcp_timer* timer, unsigned long expires) {
+   unsigned long tick = (expires + TIMER_TICK_USEC - 1) / TIMER_TICK_USEC;
+
+   pthread_mutex_lock(&wheel_lock);
+   if (timer->armed) unlink_timer(timer);
+   if (current_tick != 0 && tick <= current_tick) tick = current_tick + 1;
+   timer->tick = tick;
+   timer->generation++;
+   timer->armed = 1;
+   // Insertion en tête de l'emplacement
+   mic_tcp_timer** head = &wheel[tick % TIMER_WHEEL_SLOTS];
+   timer->prev = NULL;
+   timer->next = *head;
+   if (*head != NULL) (*head)->prev = timer;
+   *head = timer;
+   // Le thread protocole dort jusqu'à une échéance plus lointaine : on le réveille
+   if (wheel_waiting && (wake_tick == 0 || tick < wake_tick)) pthread_cond_signal(&wheel_cond);
+   pthread_mutex_unlock(&wheel_lock);
+}
+
+/*
+ * Désarme un timer ; sa fonction ne sera pas appelée même s'il vient d'échoir
+ */
+void timer_cancel(mic_tcp_timer* timer) {
+   pthread_mutex_lock(&wheel_lock);
+   if (timer->armed) unlink_timer(timer);
+   timer->generation++;
+   pthread_mutex_unlock(&wheel_lock);
+}
+
+/*
+ * Retourne 1 si le timer est armé, 0 sinon
+ */
+int timer_is_armed(mic_tcp_timer* timer) {
+   pthread_mutex_lock(&wheel_lock);
+   int armed = timer->armed;
+   pthread_mutex_unlock(&wheel_lock);
+   return armed;
+}
+
+/*
+ * Fait tourner la roue jusqu'à la date now et appelle les timers échus
+ * Les fonctions sont appelées sans le verrou de la roue : elles peuvent réarmer
+ * leur timer. Un timer réarmé ou annulé entre sa collecte et son appel est ignoré
+ */
+void timer_wheel_run(unsigned long now) {
+   unsigned long target = now / TIMER_TICK_USEC;
+   mic_tcp_timer* fired[FIRE_BATCH];
+   unsigned int generations[FIRE_BATCH];
+
+   pthread_mutex_lock(&wheel_lock);
+   if (current_tick == 0) current_tick = target - 1; // Premier tour de roue
+   while (current_tick < target) {
+      // Un retard de plus d'un tour complet revient à parcourir chaque emplacement une fois
+      unsigned long tick = target - current_tick > TIMER_WHEEL_SLOTS ? target - TIMER_WHEEL_SLOTS + 1 : current_tick + 1;
+      int nb_fired = 0;
+      mic_tcp_timer* timer = wheel[tick % TIMER_WHEEL_SLOTS];
+      while (timer != NULL && nb_fired < FIRE_BATCH) {
+         mic_tcp_timer* next = timer->next;
+         if (timer->tick <= target) {
+            unlink_timer(timer);
+            fired[nb_fired] = timer;
+            generations[nb_fired++] = timer->generation;
+         }
+         timer = next;
+      }
+      // S'il reste des timers échus dans l'emplacement, on le retraite au prochain passage
+      if (timer == NULL) current_tick = tick;
+
+      for (int i = 0; i < nb_fired; i++) {
+         if (fired[i]->generation != generations[i]) continue;
+         void (*callback)(void*) = fired[i]->callback;
+         void* arg = fired[i]->arg;
+         pthread_mutex_unlock(&wheel_lock);
+         callback(arg);
+         pthread_mutex_lock(&wheel_lock);
+      }
+   }
+   pthread_mutex_unlock(&wheel_lock);
+}
+
+/*
+ * Tick du premier emplacement non vide après current_tick, 0 si la roue est vide
+ * (le verrou de la roue doit être pris). Un timer armé pour un tour suivant
+ * provoque un réveil anticipé, sans effet
+ */
+static unsigned long next_expiry_tick(void) {
+   for (unsigned long tick = current_tick + 1; tick <= current_tick + TIMER_WHEEL_SLOTS; tick++) {
+      if (wheel[tick % TIMER_WHEEL_SLOTS] != NULL) return tick;
+   }
+   return 0;
+}
+
+/*
+ * Bloque le thread protocole jusqu'à la prochaine échéance de la roue,
+ * ou jusqu'à ce qu'un timer plus proche soit armé
+ */
+void timer_wheel_wait(void) {
+   pthread_once(&wheel_once, wheel_init);
+   pthread_mutex_lock(&wheel_lock);
+   wake_tick = next_expiry_tick();
+   wheel_waiting = 1;
+   if (wake_tick == 0) {
+      pthread_cond_wait(&wheel_cond, &wheel_lock);
+   } else {
+      unsigned long expires = wake_tick * TIMER_TICK_USEC;
+      struct timespec deadline = { expires / 1000000, (expires % 1000000) * 1000 };
+      pthread_cond_timedwait(&wheel_cond, &wheel_lock, &deadline);
+   }
+   wheel_waiting = 0;
+   pthread_mutex_unlock(&wheel_lock);
+}
@@ -0,0 +1,104 @@
+#include <mictcp_trace.h>
+#include <mictcp_log.h>
+#include <api/mictcp_core.h>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+
+trace_header* trace_file = NULL; // Fichier de trace projeté (NULL : trace désactivée)
+__thread trace_ring* thread_ring = NULL; // Anneau du thread courant
+__thread int thread_untraced = 0; // 1 si plus aucun anneau n'était libre pour ce thread
+pthread_mutex_t trace_lock = PTHREAD_MUTEX_INITIALIZER;
+
+static const char* type_names[TRACE_TYPE_COUNT] = {
+   "?", "PDU_SENT", "PDU_RETRANSMITTED", "ACK_RECEIVED", "DATA_RECEIVED", "ACK_SENT", "RTO_EXPIRED",
+   "LOSS_ACCEPTED", "LOSS_REFUSED", "CWND_REDUCED", "ESTABLISHED", "CLOSED", "IP_DROPPED", "DEADLINE_EXPIRED",
+   "FORWARD_SENT", "FORWARD_RECEIVED"
+};
+
+/*
+ * Nom d'un type d'événement
+ */
+const char* trace_type_name(int type) {
+   if (type <= 0 || type >= TRACE_TYPE_COUNT) return type_names[0];
+   return type_names[type];
+}
+
+/*
+ * Crée le fichier de trace path et l'active pour tout le processus
+ * Un seul fichier par processus : les appels suivants sont sans effet
+ * Retourne 0 si succès, -1 en cas d'erreur
+ */
+int trace_open(const char* path) {
+   size_t size = sizeof(trace_header) + TRACE_MAX_THREADS * sizeof(trace_ring);
+   pthread_mutex_lock(&trace_lock);
+   if (trace_file != NULL) {
+      pthread_mutex_unlock(&trace_lock);
+      return 0;
+   }
+   int fd = open(path, O_RDWR | O_CREAT | O_TRUNC, 0644);
+   if (fd == -1 || ftruncate(fd, size) == -1) {
+      LOG_ERROR("[MIC-TCP] Erreur: impossible de créer la trace %s\n", path);
+      if (fd != -1) close(fd);
+      pthread_mutex_unlock(&trace_lock);
+      return -1;
+   }
+   //? Fichier creux : seules les pages réellement écrites par les threads occupent le disque
+   trace_header* header = mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+   close(fd);
+   if (header == MAP_FAILED) {
+      pthread_mutex_unlock(&trace_lock);
+      return -1;
+   }
+   header->magic = TRACE_MAGIC;
+   header->version = TRACE_VERSION;
+   header->max_threads = TRACE_MAX_THREADS;
+   header->ring_events = TRACE_RING_EVENTS;
+   header->event_size = sizeof(trace_event);
+   header->threads = 0;
+   header->start_time = get_now_time_usec();
+   header->pid = getpid();
+   __atomic_store_n(&trace_file, header, __ATOMIC_RELEASE);
+   pthread_mutex_unlock(&trace_lock);
+   LOG_INFO("[MIC-TCP] Trace binaire dans %s\n", path);
+   return 0;
+}
+
+/*
+ * Attribue un anneau au thread courant lors de son premier événement
+ * Retourne l'anneau, ou NULL si tous les anneaux sont pris
+ */
+static trace_ring* claim_ring(void) {
+   unsigned int index = __atomic_fetch_add(&trace_file->threads, 1, __ATOMIC_RELAXED);
+   if (index >= TRACE_MAX_THREADS) {
+      thread_untraced = 1;
+      return NULL;
+   }
+   trace_ring* rings = (trace_ring *) (trace_file + 1);
+   thread_ring = &rings[index];
+   thread_ring->tid = syscall(SYS_gettid);
+   return thread_ring;
+}
+
+/*
+ * Ajoute un événement à l'anneau du thread courant
+ * Appelée par la macro TRACE(), seulement quand la trace est active
+ */
+void trace_record(trace_type type, int socket, uint32_t seq, uint32_t ack, uint32_t value) {
+   trace_ring* ring = thread_ring;
+   if (ring == NULL) {
+      if (thread_untraced || (ring = claim_ring()) == NULL) return;
+   }
+   //? Seul ce thread écrit dans son anneau : la position n'a pas besoin d'opération atomique
+   uint64_t head = ring->head;
+   trace_event* event = &ring->events[head & (TRACE_RING_EVENTS - 1)];
+   event->time = get_now_time_usec();
+   event->seq = seq;
+   event->ack = ack;
+   event->value = value;
+   event->socket = socket < 0 ? TRACE_NO_SOCKET : (uint16_t) socket;
+   event->type = type;
+   event->flags = 0;
+   //? Publication : un lecteur qui voit la nouvelle position voit aussi l'événement
+   __atomic_store_n(&ring->head, head + 1, __ATOMIC_RELEASE);
+}